@@ -4,6 +4,10 @@
 #include <stddef.h>
 
 #include "adc.h"
+extern "C" {
+#include "clock.h"
+#include "power.h"
+}
 
 /*
 OTC: PC1 (ADC1, AIN7 for off-time capacitor. ADC on startup, output high after)
@@ -20,16 +24,18 @@ static void ADC0_init_common() {
 	ADC0.CTRLD |= ADC_INITDLY_DLY16_gc;
 	// Set sample accumulation
 	ADC0.CTRLB = ADC_SAMPNUM_ACC4_gc;
-	// Set sample capacitance and prescaler
-	ADC0.CTRLC |= ADC_SAMPCAP_bm | ADC_PRESC_DIV16_gc;
-	// Enable ADC
-	ADC0.CTRLA |= ADC_ENABLE_bm;
+	// Set sample capacitance and prescaler for the current CPU clock
+	ADC0.CTRLC &= ~ADC_PRESC_gm;
+	ADC0.CTRLC |= ADC_SAMPCAP_bm | get_adc_prescaler();
+	// ADC is only enabled for the duration of a conversion
 }
 
 static void ADC0_init_internal_temperature() {
 	// Set VREF to 1.1V
 	VREF.CTRLA &= ~VREF_ADC0REFSEL_gm;
 	VREF.CTRLA |= VREF_ADC0REFSEL_1V1_gc;
+	// Released once the result is read
+	acquire_peripheral(PERIPHERAL_VREF_ADC0);
 	// Use internal reference
 	ADC0.CTRLC &= ~ADC_REFSEL_gm;
 	ADC0.CTRLC |= ADC_REFSEL_INTREF_gc;
@@ -50,6 +56,8 @@ static void ADC0_init_ntc_temperature() {
 }
 
 static void ADC0_start_conversion() {
+	// Enable ADC, the init delay covers VREF start-up
+	acquire_peripheral(PERIPHERAL_ADC0);
 	// Enable interrupt
 	ADC0.INTCTRL |= ADC_RESRDY_bm;
 	// Start conversion
@@ -63,6 +71,7 @@ ISR(ADC0_RESRDY_vect) {
 
 	// Divide by 4 due to sample accumulation
 	uint16_t adc0_res = ADC0.RES >> 2;
+	release_peripheral(PERIPHERAL_ADC0);
 
 	if (ADC0_cb) {
 		ADC0_cb(adc0_res);
@@ -73,6 +82,7 @@ ISR(ADC0_RESRDY_vect) {
 static void (*internal_temperature_cb)(float) = NULL;
 
 static void internal_temperature_handler(uint16_t lsb) {
+	release_peripheral(PERIPHERAL_VREF_ADC0);
 	uint8_t sigrow_gain = SIGROW.TEMPSENSE0; // Read unsigned value from signature row
 	int8_t sigrow_offset = SIGROW.TEMPSENSE1; // Read signed value from signature row
 	uint32_t temp = lsb - sigrow_offset;
@@ -133,16 +143,18 @@ static void ADC1_init_common() {
 	ADC1.CTRLD |= ADC_INITDLY_DLY16_gc;
 	// Set sample accumulation
 	ADC1.CTRLB = ADC_SAMPNUM_ACC4_gc;
-	// Set sample capacitance and prescaler
-	ADC1.CTRLC |= ADC_SAMPCAP_bm | ADC_PRESC_DIV16_gc;
-	// Enable ADC
-	ADC1.CTRLA |= ADC_ENABLE_bm;
+	// Set sample capacitance and prescaler for the current CPU clock
+	ADC1.CTRLC &= ~ADC_PRESC_gm;
+	ADC1.CTRLC |= ADC_SAMPCAP_bm | get_adc_prescaler();
+	// ADC is only enabled for the duration of a conversion
 }
 
 static void ADC1_init_battery_level() {
 	// Set VREF to 1.5V
 	VREF.CTRLC &= ~VREF_ADC1REFSEL_gm;
 	VREF.CTRLC |= VREF_ADC1REFSEL_1V5_gc;
+	// Released once the result is read
+	acquire_peripheral(PERIPHERAL_VREF_ADC1);
 	// Use internal reference
 	ADC1.CTRLC &= ~ADC_REFSEL_gm;
 	ADC1.CTRLC |= ADC_REFSEL_INTREF_gc;
@@ -156,6 +168,8 @@ static void ADC1_init_off_time_capacitor() {
 	// Set VREF to 2.5V
 	VREF.CTRLC &= ~VREF_ADC1REFSEL_gm;
 	VREF.CTRLC |= VREF_ADC1REFSEL_2V5_gc;
+	// Released once the result is read
+	acquire_peripheral(PERIPHERAL_VREF_ADC1);
 	// Use internal reference
 	ADC1.CTRLC &= ~ADC_REFSEL_gm;
 	ADC1.CTRLC |= ADC_REFSEL_INTREF_gc;
@@ -165,7 +179,34 @@ static void ADC1_init_off_time_capacitor() {
 	ADC1_init_common();
 }
 
+static void ADC1_init_vdd() {
+	// Set VREF to 1.1V
+	VREF.CTRLC &= ~VREF_ADC1REFSEL_gm;
+	VREF.CTRLC |= VREF_ADC1REFSEL_1V1_gc;
+	// Released once the result is read
+	acquire_peripheral(PERIPHERAL_VREF_ADC1);
+	// Use VDD as reference
+	ADC1.CTRLC &= ~ADC_REFSEL_gm;
+	ADC1.CTRLC |= ADC_REFSEL_VDDREF_gc;
+	// Measure internal reference against VDD
+	ADC1.MUXPOS = ADC_MUXPOS_INTREF_gc;
+
+	ADC1_init_common();
+}
+
+static void ADC1_init_off_time_capacitor_vdd() {
+	// Use VDD as reference, VC can exceed the 2.5V internal reference
+	ADC1.CTRLC &= ~ADC_REFSEL_gm;
+	ADC1.CTRLC |= ADC_REFSEL_VDDREF_gc;
+	// Measure AIN7 for off-time capacitor
+	ADC1.MUXPOS = ADC_MUXPOS_AIN7_gc;
+
+	ADC1_init_common();
+}
+
 static void ADC1_start_conversion() {
+	// Enable ADC, the init delay covers VREF start-up
+	acquire_peripheral(PERIPHERAL_ADC1);
 	// Enable interrupt
 	ADC1.INTCTRL |= ADC_RESRDY_bm;
 	// Start conversion
@@ -179,6 +220,7 @@ ISR(ADC1_RESRDY_vect) {
 
 	// Divide by 4 due to sample accumulation
 	uint16_t adc1_res = ADC1.RES >> 2;
+	release_peripheral(PERIPHERAL_ADC1);
 
 	if (ADC1_cb) {
 		ADC1_cb(adc1_res);
@@ -207,6 +249,7 @@ static float ADC1_get_vref() {
 static void (*battery_level_cb)(float) = NULL;
 
 static void battery_level_handler(uint16_t lsb) {
+	release_peripheral(PERIPHERAL_VREF_ADC1);
 	if (battery_level_cb) {
 		// Gain from to potential divider
 		static const float GAIN = 3.0f;
@@ -222,12 +265,32 @@ void get_battery_level(void (*cb)(float)) {
 	ADC1_start_conversion();
 }
 
+static void (*vdd_cb)(float) = NULL;
+
+static void vdd_handler(uint16_t lsb) {
+	release_peripheral(PERIPHERAL_VREF_ADC1);
+	if (vdd_cb) {
+		// lsb/1023 = 1.1V/VDD
+		vdd_cb(lsb ? 1.1f * 1023 / lsb : 0);
+		vdd_cb = NULL;
+	}
+}
+
+void get_vdd(void (*cb)(float)) {
+	ADC1_init_vdd();
+	ADC1_cb = vdd_handler;
+	vdd_cb = cb;
+	ADC1_start_conversion();
+}
+
+static const float OFF_TIME_R = 750e3; // 750kOhms
+static const float OFF_TIME_C = 4.7e-6; // 4.7uF
+static const float OFF_TIME_RC = OFF_TIME_R * OFF_TIME_C;
+
 static void (*off_time_cb)(float) = NULL;
 
 static void off_time_handler(uint16_t lsb) {
-	static const float R = 750e3; // 750kOhms
-	static const float C = 4.7e-6; // 4.7uF
-	static const float RC = R * C;
+	release_peripheral(PERIPHERAL_VREF_ADC1);
 
 	// Vc/Vs = exp(-t/RC)
 	// t = -RC * ln(Vc/Vs)
@@ -235,11 +298,11 @@ static void off_time_handler(uint16_t lsb) {
 	// leaving diode's forward voltage ~0.35V (empirical value)
 	static const float vs = 0.35f;
 	float vc = ADC1_get_vref() * lsb / 1023;
-	float off_time = -RC * logf(vc / vs);
+	float off_time = -OFF_TIME_RC * logf(vc / vs);
 
 	// If OTC is not clamped, use VDD as reference
 	// and calculate off_time the ratiometric way
-	// float off_time = -RC * logf(lsb / 1023.0f);
+	// float off_time = -OFF_TIME_RC * logf(lsb / 1023.0f);
 
 	if (off_time_cb) {
 		off_time_cb(off_time);
@@ -252,4 +315,27 @@ void get_off_time(void (*cb)(float)) {
 	ADC1_cb = off_time_handler;
 	off_time_cb = cb;
 	ADC1_start_conversion();
+}
+
+static float off_time_vs = 0;
+static float off_time_vdd = 0;
+
+static void off_time_from_handler(uint16_t lsb) {
+	// Vc/Vs = exp(-t/RC), with Vs given instead of the diode clamp
+	float vc = off_time_vdd * lsb / 1023;
+	float off_time = -OFF_TIME_RC * logf(vc / off_time_vs);
+
+	if (off_time_cb) {
+		off_time_cb(off_time);
+		off_time_cb = NULL;
+	}
+}
+
+void get_off_time_from(float vs, float vdd, void (*cb)(float)) {
+	ADC1_init_off_time_capacitor_vdd();
+	off_time_vs = vs;
+	off_time_vdd = vdd;
+	ADC1_cb = off_time_from_handler;
+	off_time_cb = cb;
+	ADC1_start_conversion();
 }
\ No newline at end of file
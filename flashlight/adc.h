@@ -10,5 +10,9 @@ void get_ntc_temperature(void (*cb)(float));
 bool ADC1_is_converting();
 void get_battery_level(void (*cb)(float));
 void get_off_time(void (*cb)(float));
+// VDD from the 1.1V reference measured against it
+void get_vdd(void (*cb)(float));
+// Off-time for a capacitor that started at vs instead of the diode clamp, vdd from get_vdd()
+void get_off_time_from(float vs, float vdd, void (*cb)(float));
 
 #endif /* ADC_H_ */
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include <avr/io.h>
 
-#include <math.h>
 #include <stdbool.h>
 
 #include "brightness.h"
@@ -9,117 +8,123 @@ extern "C" {
 #include "dac.h"
 }
 
-struct BrightnessGroup {
-	bool hdr;
-	uint8_t dac_vref;
-	uint8_t dac_value_min;
-	uint8_t dac_value_step_count;
-	brightness_t brightness_min;
-	brightness_t brightness_max;
-};
-
-// Prioritise efficiency: Switch to HDR as soon as possible, 652 possible brightness settings
-// Prioritise resolution: 1095 possible brightness settings
-#define PRIORITISE_EFFICIENCY 1
-
-static const BrightnessGroup BRIGHTNESS_GROUPS[] = {
-#if PRIORITISE_EFFICIENCY
-	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_0V55_gc, .dac_value_min = 0, .dac_value_step_count = 100, .brightness_min = 0U, .brightness_max = 3705461U },
-	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_1V1_gc, .dac_value_min = 50, .dac_value_step_count = 0, .brightness_min = 3705461U, .brightness_max = 3705461U },
-	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_0V55_gc, .dac_value_min = 1, .dac_value_step_count = 254, .brightness_min = 3705461U, .brightness_max = 944892804U },
-	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_1V1_gc, .dac_value_min = 128, .dac_value_step_count = 127, .brightness_min = 948598266U, .brightness_max = 1889785609U },
-	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_1V5_gc, .dac_value_min = 187, .dac_value_step_count = 68, .brightness_min = 1889785609U, .brightness_max = 2576980377U },
-	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_2V5_gc, .dac_value_min = 153, .dac_value_step_count = 102, .brightness_min = 2576980377U, .brightness_max = 4294967295U },
-#else
-	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_0V55_gc, .dac_value_min = 0, .dac_value_step_count = 255, .brightness_min = 0U, .brightness_max = 9448928U },
-	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_1V1_gc, .dac_value_min = 128, .dac_value_step_count = 127, .brightness_min = 9485982U, .brightness_max = 18897856U },
-	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_1V5_gc, .dac_value_min = 187, .dac_value_step_count = 68, .brightness_min = 18897856U, .brightness_max = 25769803U },
-	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_2V5_gc, .dac_value_min = 153, .dac_value_step_count = 102, .brightness_min = 25769803U, .brightness_max = 42949672U },
-	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_0V55_gc, .dac_value_min = 12, .dac_value_step_count = 243, .brightness_min = 44465543U, .brightness_max = 944892804U },
-	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_1V1_gc, .dac_value_min = 128, .dac_value_step_count = 127, .brightness_min = 948598266U, .brightness_max = 1889785609U },
-	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_1V5_gc, .dac_value_min = 187, .dac_value_step_count = 68, .brightness_min = 1889785609U, .brightness_max = 2576980377U },
-	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_2V5_gc, .dac_value_min = 153, .dac_value_step_count = 102, .brightness_min = 2576980377U, .brightness_max = 4294967295U },
-#endif
-};
-
-static const uint8_t BRIGHTNESS_GROUPS_SIZE = sizeof(BRIGHTNESS_GROUPS) / sizeof(BrightnessGroup);
+static brightness_t brightness_prev = 0;
+static int8_t group_prev = -1;
+static BrightnessTransitions transitions = {};
 
-static int8_t binary_search(brightness_t brightness) {
-	uint8_t left = 0;
-	uint8_t right = BRIGHTNESS_GROUPS_SIZE - 1;
-	while (left < right) {
-		uint8_t mid = left + (right - left) / 2;
-		if (brightness < BRIGHTNESS_GROUPS[mid].brightness_min) {
-			right = mid - 1;
-		} else if (brightness > BRIGHTNESS_GROUPS[mid].brightness_max) {
-			left = mid + 1;
-		} else {
-			return mid;
-		}
-		if (left == right) {
-			return left;
-		}
-	}
-	// Fell between the gaps, choose lower
-	if (left < right) {
-		return left;
-	} else {
-		return right;
-	}
-	// This shouldn't be possible
-	return -1;
+brightness_t get_brightness() {
+	return brightness_prev;
 }
 
-static brightness_t brightness_prev = 0;
-
-void set_brightness(brightness_t brightness) {
-	if (get_uvlo()) {
-		brightness = 0;
-	}
+// Returns true if brightness is already applied
+static bool prepare_output(brightness_t brightness) {
 	if (brightness != 0) {
 		if (get_boost_state() != ENABLED) {
 			enable_boost();
 		}
 		if (brightness == brightness_prev) {
-			return;
+			return true;
 		}
 	}
-	// Binary search for appropriate group
-	int8_t index = binary_search(brightness);
-	if (index < 0) {
-		index = 0;
-		brightness = 0;
+	return false;
+}
+
+// Group hysteresis: stay in the current group while its DAC can still reach the brightness,
+// allowing 1/8 of the DAC codes beyond the group's nominal edges
+// Stops HDR/VREF toggling when brightness alternates across an edge, e.g. 3705000/3706000
+// The lower margin is 1/8 of the group's lowest code, so groups starting at code 0 or 1
+// have none: below code 1 there is only code 0, which is off. In the efficiency table the
+// HDR 0V55 group therefore leaves as soon as brightness drops under its edge, and the
+// HDR/non-HDR band lies entirely above the edge, in the non-HDR group's upper margin
+static bool hold_group(brightness_t brightness, BrightnessPreset& preset) {
+	if (group_prev < 0 || brightness == 0) {
+		return false;
 	}
-	const BrightnessGroup& bg = BRIGHTNESS_GROUPS[index];
-	// Make sure brightness is within range
-	if (brightness < bg.brightness_min) {
-		brightness = bg.brightness_min;
-	} else if (brightness > bg.brightness_max) {
-		brightness = bg.brightness_max;
+	const BrightnessGroup& bg = BRIGHTNESS_GROUPS[group_prev];
+	if (bg.dac_value_step_count == 0) {
+		return false;
 	}
-	// Calculate nearest DAC value
-	uint8_t dac_value = bg.dac_value_min;
-	if (bg.dac_value_step_count != 0) {
-		dac_value = bg.dac_value_min + roundf((float)bg.dac_value_step_count * (brightness - bg.brightness_min)) / (bg.brightness_max - bg.brightness_min);
+	uint8_t dac_value;
+	if (brightness >= bg.brightness_min && brightness <= bg.brightness_max) {
+		dac_value = brightness_group_dac_value(bg, brightness);
+	} else {
+		// Extrapolate the group's linear mapping past its edges
+		float brightness_per_code = (float)(bg.brightness_max - bg.brightness_min) / bg.dac_value_step_count;
+		float code = bg.dac_value_min + ((float)brightness - (float)bg.brightness_min) / brightness_per_code;
+		uint8_t dac_value_max = bg.dac_value_min + bg.dac_value_step_count;
+		uint8_t code_min = bg.dac_value_min - bg.dac_value_min / 8;
+		uint16_t code_max = dac_value_max + dac_value_max / 8;
+		if (code_max > 255) {
+			code_max = 255;
+		}
+		if (code < code_min || code > code_max) {
+			return false;
+		}
+		dac_value = code;
 	}
-	// Apply changes
-	if (bg.dac_vref != DAC0_get_vref()) {
-		DAC0_set_vref(bg.dac_vref);
+	preset = BrightnessPreset { brightness, bg.hdr, bg.dac_vref, dac_value, group_prev };
+	return true;
+}
+
+static void apply_output(const BrightnessPreset& preset) {
+	// Apply changes in a fixed order: DAC data, VREF, HDR
+	if (preset.dac_value != DAC0_get_data()) {
+		DAC0_set_data(preset.dac_value);
 	}
-	if (dac_value != DAC0_get_data()) {
-		DAC0_set_data(dac_value);
+	if (preset.dac_vref != DAC0_get_vref()) {
+		DAC0_set_vref(preset.dac_vref);
+		transitions.vref++;
 	}
-	if (bg.hdr) {
+	if (preset.hdr) {
 		if (get_hdr_state() != ENABLED) {
 			enable_hdr();
+			transitions.hdr++;
 		}
 	} else {
 		if (get_hdr_state() != DISABLED) {
 			disable_hdr();
+			transitions.hdr++;
 		}
 	}
-	if (brightness == 0) {
+	if (preset.brightness == 0) {
 		disable_boost();
 	}
-	brightness_prev = brightness;
+	if (preset.group != group_prev) {
+		transitions.group++;
+	}
+	brightness_prev = preset.brightness;
+	group_prev = preset.group;
+}
+
+void set_brightness(brightness_t brightness) {
+	if (get_uvlo()) {
+		brightness = 0;
+	}
+	if (prepare_output(brightness)) {
+		return;
+	}
+	BrightnessPreset preset;
+	if (!hold_group(brightness, preset)) {
+		preset = make_brightness_preset(brightness);
+	}
+	apply_output(preset);
+}
+
+void apply_brightness_preset(const BrightnessPreset& preset) {
+	if (get_uvlo()) {
+		set_brightness(0);
+		return;
+	}
+	if (prepare_output(preset.brightness)) {
+		return;
+	}
+	apply_output(preset);
+}
+
+BrightnessTransitions get_brightness_transitions() {
+	return transitions;
+}
+
+void reset_brightness_transitions() {
+	transitions = BrightnessTransitions {};
 }
\ No newline at end of file
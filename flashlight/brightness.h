@@ -1,11 +1,125 @@
 #ifndef BRIGHTNESS_H_
 #define BRIGHTNESS_H_
 
+#include <avr/io.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef uint32_t brightness_t;
 #define BRIGHTNESS_MAX ((brightness_t)0xFFFFFFFF)
 
+struct BrightnessGroup {
+	bool hdr;
+	uint8_t dac_vref;
+	uint8_t dac_value_min;
+	uint8_t dac_value_step_count;
+	brightness_t brightness_min;
+	brightness_t brightness_max;
+};
+
+// Prioritise efficiency: Switch to HDR as soon as possible, 652 possible brightness settings
+// Prioritise resolution: 1095 possible brightness settings
+#ifndef PRIORITISE_EFFICIENCY
+#define PRIORITISE_EFFICIENCY 1
+#endif
+
+static constexpr BrightnessGroup BRIGHTNESS_GROUPS[] = {
+#if PRIORITISE_EFFICIENCY
+	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_0V55_gc, .dac_value_min = 0, .dac_value_step_count = 100, .brightness_min = 0U, .brightness_max = 3705461U },
+	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_1V1_gc, .dac_value_min = 50, .dac_value_step_count = 0, .brightness_min = 3705461U, .brightness_max = 3705461U },
+	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_0V55_gc, .dac_value_min = 1, .dac_value_step_count = 254, .brightness_min = 3705461U, .brightness_max = 944892804U },
+	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_1V1_gc, .dac_value_min = 128, .dac_value_step_count = 127, .brightness_min = 948598266U, .brightness_max = 1889785609U },
+	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_1V5_gc, .dac_value_min = 187, .dac_value_step_count = 68, .brightness_min = 1889785609U, .brightness_max = 2576980377U },
+	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_2V5_gc, .dac_value_min = 153, .dac_value_step_count = 102, .brightness_min = 2576980377U, .brightness_max = 4294967295U },
+#else
+	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_0V55_gc, .dac_value_min = 0, .dac_value_step_count = 255, .brightness_min = 0U, .brightness_max = 9448928U },
+	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_1V1_gc, .dac_value_min = 128, .dac_value_step_count = 127, .brightness_min = 9485982U, .brightness_max = 18897856U },
+	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_1V5_gc, .dac_value_min = 187, .dac_value_step_count = 68, .brightness_min = 18897856U, .brightness_max = 25769803U },
+	{ .hdr = false, .dac_vref = VREF_DAC0REFSEL_2V5_gc, .dac_value_min = 153, .dac_value_step_count = 102, .brightness_min = 25769803U, .brightness_max = 42949672U },
+	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_0V55_gc, .dac_value_min = 12, .dac_value_step_count = 243, .brightness_min = 44465543U, .brightness_max = 944892804U },
+	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_1V1_gc, .dac_value_min = 128, .dac_value_step_count = 127, .brightness_min = 948598266U, .brightness_max = 1889785609U },
+	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_1V5_gc, .dac_value_min = 187, .dac_value_step_count = 68, .brightness_min = 1889785609U, .brightness_max = 2576980377U },
+	{ .hdr = true, .dac_vref = VREF_DAC0REFSEL_2V5_gc, .dac_value_min = 153, .dac_value_step_count = 102, .brightness_min = 2576980377U, .brightness_max = 4294967295U },
+#endif
+};
+
+static constexpr uint8_t BRIGHTNESS_GROUPS_SIZE = sizeof(BRIGHTNESS_GROUPS) / sizeof(BrightnessGroup);
+
+constexpr int8_t binary_search(brightness_t brightness) {
+	uint8_t left = 0;
+	uint8_t right = BRIGHTNESS_GROUPS_SIZE - 1;
+	while (left < right) {
+		uint8_t mid = left + (right - left) / 2;
+		if (brightness < BRIGHTNESS_GROUPS[mid].brightness_min) {
+			right = mid - 1;
+		} else if (brightness > BRIGHTNESS_GROUPS[mid].brightness_max) {
+			left = mid + 1;
+		} else {
+			return mid;
+		}
+		if (left == right) {
+			return left;
+		}
+	}
+	// Fell between the gaps, choose lower
+	if (left < right) {
+		return left;
+	} else {
+		return right;
+	}
+	// This shouldn't be possible
+	return -1;
+}
+
+// Nearest DAC value within a group, brightness must already be clamped to it
+constexpr uint8_t brightness_group_dac_value(const BrightnessGroup& bg, brightness_t brightness) {
+	if (bg.dac_value_step_count == 0) {
+		return bg.dac_value_min;
+	}
+	return bg.dac_value_min + (float)bg.dac_value_step_count * (brightness - bg.brightness_min) / (bg.brightness_max - bg.brightness_min);
+}
+
+// Everything set_brightness() derives from a brightness value
+struct BrightnessPreset {
+	brightness_t brightness;
+	bool hdr;
+	uint8_t dac_vref;
+	uint8_t dac_value;
+	int8_t group;
+};
+
+constexpr BrightnessPreset make_brightness_preset(brightness_t brightness) {
+	// Binary search for appropriate group
+	int8_t index = binary_search(brightness);
+	if (index < 0) {
+		index = 0;
+		brightness = 0;
+	}
+	const BrightnessGroup& bg = BRIGHTNESS_GROUPS[index];
+	// Make sure brightness is within range
+	if (brightness < bg.brightness_min) {
+		brightness = bg.brightness_min;
+	} else if (brightness > bg.brightness_max) {
+		brightness = bg.brightness_max;
+	}
+	return BrightnessPreset { brightness, bg.hdr, bg.dac_vref, brightness_group_dac_value(bg, brightness), index };
+}
+
 void set_brightness(brightness_t brightness);
+// For constant levels, resolve with a constexpr make_brightness_preset()
+void apply_brightness_preset(const BrightnessPreset& preset);
+brightness_t get_brightness();
+
+// Output switches caused by brightness changes
+// A monotonic ramp crosses each group edge once either way with or without hysteresis,
+// the counts only drop where brightness hovers around an edge
+struct BrightnessTransitions {
+	uint16_t group;
+	uint16_t vref;
+	uint16_t hdr;
+};
+
+BrightnessTransitions get_brightness_transitions();
+void reset_brightness_transitions();
 
 #endif /* BRIGHTNESS_H_ */
\ No newline at end of file
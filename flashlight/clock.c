@@ -0,0 +1,67 @@
+#include <avr/io.h>
+#include <util/delay_basic.h>
+
+#include "clock.h"
+#include "strobe.h"
+#include "usart.h"
+
+// A single Li-ion cell never reaches the 4.5 V needed for 20 MHz
+#define ALLOW_20MHZ 0
+
+typedef struct {
+	uint32_t f_cpu;
+	uint8_t mclkctrlb;
+	// Keeps CLK_ADC at 150-210 kHz so ADC_INITDLY_DLY16 still covers VREF start-up
+	uint8_t adc_prescaler;
+} CpuClock;
+
+static const CpuClock CPU_CLOCKS[CLOCK_MAX] = {
+	[CLOCK_1MHZ25] = { .f_cpu = 1250000UL, .mclkctrlb = CLKCTRL_PDIV_16X_gc | CLKCTRL_PEN_bm, .adc_prescaler = ADC_PRESC_DIV8_gc },
+	[CLOCK_3MHZ33] = { .f_cpu = 3333333UL, .mclkctrlb = CLKCTRL_PDIV_6X_gc | CLKCTRL_PEN_bm, .adc_prescaler = ADC_PRESC_DIV16_gc },
+	[CLOCK_10MHZ] = { .f_cpu = 10000000UL, .mclkctrlb = CLKCTRL_PDIV_2X_gc | CLKCTRL_PEN_bm, .adc_prescaler = ADC_PRESC_DIV64_gc },
+	[CLOCK_20MHZ] = { .f_cpu = 20000000UL, .mclkctrlb = 0, .adc_prescaler = ADC_PRESC_DIV128_gc },
+};
+
+static cpu_clock_t cpu_clock = CLOCK_3MHZ33;
+
+cpu_clock_t get_cpu_clock() {
+	return cpu_clock;
+}
+
+void set_cpu_clock(cpu_clock_t clock) {
+#if !ALLOW_20MHZ
+	if (clock == CLOCK_20MHZ) {
+		clock = CLOCK_10MHZ;
+	}
+#endif
+	if (clock == cpu_clock || clock >= CLOCK_MAX) {
+		return;
+	}
+	// Let conversions and transmissions finish at the old clock
+	while ((ADC0.COMMAND | ADC1.COMMAND) & ADC_STCONV_bm);
+	USART0_flush();
+
+	_PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, CPU_CLOCKS[clock].mclkctrlb);
+	cpu_clock = clock;
+
+	// Recalculate everything derived from CLK_PER
+	// ADC prescaler is applied by the next conversion, RTC runs from 32 kHz
+	USART0_update_baud();
+	update_strobe_clock();
+}
+
+uint32_t get_f_cpu() {
+	return CPU_CLOCKS[cpu_clock].f_cpu;
+}
+
+uint8_t get_adc_prescaler() {
+	return CPU_CLOCKS[cpu_clock].adc_prescaler;
+}
+
+void delay_ms(uint16_t ms) {
+	// _delay_loop_2() takes 4 cycles per iteration
+	uint16_t iterations = get_f_cpu() / 4000;
+	while (ms--) {
+		_delay_loop_2(iterations);
+	}
+}
\ No newline at end of file
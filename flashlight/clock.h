@@ -0,0 +1,26 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <stdint.h>
+
+// Main clock is OSC20M divided down by the CLKCTRL prescaler
+// 10 MHz needs VDD >= 2.7 V, 20 MHz needs VDD >= 4.5 V
+// Battery level needed before switching to 10 MHz, margin for the drop to VDD
+#define CLOCK_10MHZ_MIN_VOLTS 2.9f
+typedef enum {
+	CLOCK_1MHZ25, // 20 MHz / 16, steady light
+	CLOCK_3MHZ33, // 20 MHz / 6, default after reset
+	CLOCK_10MHZ, // 20 MHz / 2, bursts
+	CLOCK_20MHZ, // Prescaler disabled, see ALLOW_20MHZ
+	CLOCK_MAX,
+} cpu_clock_t;
+
+cpu_clock_t get_cpu_clock();
+void set_cpu_clock(cpu_clock_t clock);
+uint32_t get_f_cpu();
+uint8_t get_adc_prescaler();
+
+// Busy wait that follows the current clock, unlike _delay_ms()
+void delay_ms(uint16_t ms);
+
+#endif /* CLOCK_H_ */
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include <avr/io.h>
+
+#include "pin.h"
+#include "protection.h"
+extern "C" {
+#include "clock.h"
+#include "control.h"
+#include "dac.h"
+#include "recorder.h"
+}
+
+/*
+nINV: PA1 (output, pulls OPAMP- down, then input/high-Z)
+INV: PA2 (output, drives N-FET gate)
+HDR: PA3 (output, drives N-FET gate)
+nHDR: PA4 (output, hacked to drive N-FET gate)
+EN: PA7 (output, enables op-amp and MP3432, gated by AC0 through CCL LUT1 if USE_THERMAL_TRIP)
+*/
+
+typedef Pin<Port::A, PIN1_bp> nINV;
+typedef Pin<Port::A, PIN2_bp> INV;
+
+typedef Pin<Port::A, PIN3_bp> HDR;
+typedef Pin<Port::A, PIN4_bp> nHDR;
+
+typedef Pin<Port::A, PIN7_bp> EN;
+
+// SBI/CBI only reach the lower 32 I/O addresses
+static_assert(HDR::out_addr < 0x20 && nHDR::dir_addr < 0x20, "HDR gate pair needs SBI/CBI");
+
+#define USE_STARTUP_FLASH_FIX 1
+#define FLASH_FIX_PRE_DELAY_MS 1
+#define FLASH_FIX_POST_DELAY_MS 10
+
+static bool uvlo = false;
+static state_t boost_state = INVALID;
+static state_t hdr_state = INVALID;
+
+bool get_uvlo() {
+	return uvlo;
+}
+
+void set_uvlo() {
+	if (!uvlo) {
+		record(RECORD_UVLO, 1);
+	}
+	uvlo = true;
+}
+
+void reset_uvlo() {
+	if (uvlo) {
+		record(RECORD_UVLO, 0);
+	}
+	uvlo = false;
+}
+
+void enable_inv() {
+	// Preload output levels, then drive both gates in a single write
+	INV::high();
+	nINV::low();
+	PinGroup<INV, nINV>::output();
+}
+
+void disable_inv() {
+	PinGroup<INV, nINV>::input();
+}
+
+state_t get_hdr_state() {
+	return hdr_state;
+}
+
+void enable_hdr() {
+	if (hdr_state == ENABLED) {
+		return;
+	}
+	HDR::output();
+	// HDR high, then nHDR released, hardware hacked to drive N-FET with pull-down
+	// One asm block, so the edges are HDR_GATE_SKEW_CYCLES apart in every build
+	asm volatile(
+		"sbi %[hdr_out], %[hdr_bit]\n\t"
+		"cbi %[nhdr_dir], %[nhdr_bit]"
+		:: [hdr_out] "I" (HDR::out_addr), [hdr_bit] "I" (HDR::bit),
+		[nhdr_dir] "I" (nHDR::dir_addr), [nhdr_bit] "I" (nHDR::bit)
+		: "memory");
+	hdr_state = ENABLED;
+	record(RECORD_HDR, ENABLED);
+}
+
+void disable_hdr() {
+	if (hdr_state == DISABLED) {
+		return;
+	}
+	// Hardware hacked, gate pull-up removed, drive required
+	HDR::output();
+	// Hardware hacked, nHDR drives N-FET
+	// Preload high while still an input, so only the DIR write switches it
+	nHDR::high();
+	// HDR low, then nHDR driven, HDR_GATE_SKEW_CYCLES apart
+	asm volatile(
+		"cbi %[hdr_out], %[hdr_bit]\n\t"
+		"sbi %[nhdr_dir], %[nhdr_bit]"
+		:: [hdr_out] "I" (HDR::out_addr), [hdr_bit] "I" (HDR::bit),
+		[nhdr_dir] "I" (nHDR::dir_addr), [nhdr_bit] "I" (nHDR::bit)
+		: "memory");
+	hdr_state = DISABLED;
+	record(RECORD_HDR, DISABLED);
+}
+
+state_t get_boost_state() {
+	return boost_state;
+}
+
+void enable_boost() {
+	if (uvlo || is_tripped() || boost_state == ENABLED) {
+		return;
+	}
+	// DAC sets the LED current, it must be running before EN
+	DAC0_enable();
+#if USE_STARTUP_FLASH_FIX
+	enable_inv();
+	delay_ms(FLASH_FIX_PRE_DELAY_MS);
+#endif
+	// A trip during the delay must not be overridden
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (!is_tripped()) {
+			// Enable MP3432 and op-amp
+			EN::output();
+#if USE_THERMAL_TRIP
+			// AC0 gates EN in hardware, the PORT output stays low
+			connect_en_gate();
+#else
+			EN::high();
+#endif
+		}
+	}
+#if USE_STARTUP_FLASH_FIX
+	delay_ms(FLASH_FIX_POST_DELAY_MS);
+	disable_inv();
+#endif
+	if (is_tripped()) {
+		DAC0_disable();
+		return;
+	}
+	boost_state = ENABLED;
+	record(RECORD_BOOST, ENABLED);
+}
+
+void disable_boost() {
+	if (boost_state == DISABLED) {
+		return;
+	}
+	// Disable MP3432 and op-amp
+#if USE_THERMAL_TRIP
+	disconnect_en_gate();
+#endif
+	EN::input();
+	EN::low();
+	DAC0_disable();
+	boost_state = DISABLED;
+	record(RECORD_BOOST, DISABLED);
+}
\ No newline at end of file
@@ -17,6 +17,11 @@ void reset_uvlo();
 void enable_inv();
 void disable_inv();
 
+// Cycles between the HDR and nHDR gate edges. enable_hdr()/disable_hdr() emit
+// them as one inline asm SBI/CBI pair, and SBI/CBI take 1 cycle on AVRxt.
+// Fixed by the instruction sequence, not measured on the pins.
+#define HDR_GATE_SKEW_CYCLES 1
+
 state_t get_hdr_state();
 void enable_hdr();
 void disable_hdr();
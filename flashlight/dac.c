@@ -1,16 +1,38 @@
 #include <avr/io.h>
+#include <stdbool.h>
 
 #include "dac.h"
+#include "power.h"
 
 /*
 DAC: PA6 (output)
 */
 
 void DAC0_init() {
-	PORTA.DIRSET = PIN6_bm;
+	VPORTA.DIR |= PIN6_bm;
 	DAC0_set_vref(VREF_DAC0REFSEL_0V55_gc);
 	DAC0_set_data(0);
-	DAC0.CTRLA = DAC_ENABLE_bm | DAC_OUTEN_bm;
+	// Enabled only while the output is needed, see DAC0_enable()
+}
+
+static bool enabled = false;
+
+void DAC0_enable() {
+	if (enabled) {
+		return;
+	}
+	acquire_peripheral(PERIPHERAL_VREF_DAC0);
+	acquire_peripheral(PERIPHERAL_DAC0);
+	enabled = true;
+}
+
+void DAC0_disable() {
+	if (!enabled) {
+		return;
+	}
+	release_peripheral(PERIPHERAL_DAC0);
+	release_peripheral(PERIPHERAL_VREF_DAC0);
+	enabled = false;
 }
 
 uint8_t DAC0_get_vref() {
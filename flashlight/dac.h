@@ -2,6 +2,8 @@
 #define DAC_H_
 
 void DAC0_init();
+void DAC0_enable();
+void DAC0_disable();
 uint8_t DAC0_get_vref();
 void DAC0_set_vref(uint8_t vref);
 uint8_t DAC0_get_data();
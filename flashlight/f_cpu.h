@@ -1,6 +1,7 @@
 #ifndef F_CPU_H_
 #define F_CPU_H_
 
+// Main clock after reset (20 MHz / 6), see clock.h for runtime changes
 #define F_CPU 3333333UL
 
 #endif /* F_CPU_H_ */
\ No newline at end of file
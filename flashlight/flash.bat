@@ -1 +1,2 @@
+pymcuprog -t uart -u com19 -d attiny1616 write -m fuses -o 1 -l 0x45
 pymcuprog -t uart -u com19 -d attiny1616 write -f ./Debug/flashlight.hex --erase --verify
\ No newline at end of file
@@ -1,38 +1,48 @@
-#include "f_cpu.h"
-
 #include <avr/interrupt.h>
 #include <avr/io.h>
-#include <util/delay.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
 #include <stdbool.h>
 #include <stdio.h>
 
 #include "adc.h"
 #include "brightness.h"
+#include "modes.h"
+#include "pin.h"
+#include "protection.h"
 extern "C" {
+#include "clock.h"
 #include "control.h"
 #include "dac.h"
 #include "eeprom.h"
+#include "power.h"
+#include "recorder.h"
+#include "recovery.h"
 #include "rtc.h"
+#include "strobe.h"
 #include "usart.h"
 };
 
 #define CLICK_GRACE_PERIOD_SECONDS 1
-#define UVLO_VOLTS 3
+// Longer dropouts boot normally, as after a power cycle
+// Measured from the nominal BOD level, its tolerance moves this by ~0.13 s
+#define RECOVERY_MAX_DROPOUT_SECONDS 0.2f
+// Recoveries in a row before stepping down to MODE_LOW
+#define RECOVERY_STEP_DOWN_COUNT 3
+// Run time after which recoveries no longer count as in a row
+#define RECOVERY_STABLE_SECONDS 5
 
 /*
 BAT_EN: PB0 (output)
 OTC: PC1 (ADC input, then output)
 */
 
-#define BAT_EN_PORT PORTB
-#define BAT_EN_PIN PIN0_bm
+typedef Pin<Port::B, PIN0_bp> BAT_EN;
 
-#define OTC_PORT PORTC
-#define OTC_PIN PIN1_bm
+typedef Pin<Port::C, PIN1_bp> OTC;
 
 // LED is external, for debugging
-#define LED_PORT PORTB
-#define LED_PIN PIN5_bm
+typedef Pin<Port::B, PIN5_bp> LED;
 
 // ====================
 // ===== Off-Time =====
@@ -40,8 +50,8 @@ OTC: PC1 (ADC input, then output)
 
 static void off_time_handler(float off_time) {
 	// Set pin to output to charge off-time capacitor
-	OTC_PORT.OUTSET = OTC_PIN;
-	OTC_PORT.DIRSET = OTC_PIN;
+	OTC::high();
+	OTC::output();
 	// printf("off-time: %.2fs\r\n", (double)off_time);
 
 	uint8_t click_counter = load_click_counter();
@@ -56,7 +66,7 @@ static void off_time_handler(float off_time) {
 
 static void check_off_time() {
 	// Set pin to input
-	OTC_PORT.DIRCLR = OTC_PIN;
+	OTC::input();
 	get_off_time(off_time_handler);
 }
 
@@ -72,11 +82,13 @@ static bool use_internal_temperature = false;
 
 static void internal_temperature_handler(float temperature) {
 	use_internal_temperature = false;
+	record_delta(RECORD_INTERNAL_TEMPERATURE, (int16_t)(kelvin_to_celsius(temperature) * 100), 100);
 	printf("internal temp.: %.0f C\r\n", (double)kelvin_to_celsius(temperature));
 }
 
 static void ntc_temperature_handler(float temperature) {
 	use_internal_temperature = true;
+	record_delta(RECORD_NTC_TEMPERATURE, (int16_t)(kelvin_to_celsius(temperature) * 100), 100);
 	printf("NTC temp.: %.2f C\r\n", (double)kelvin_to_celsius(temperature));
 }
 
@@ -93,90 +105,273 @@ static void check_temperatures() {
 // =========================
 
 static void battery_level_handler(float battery_level) {
-	BAT_EN_PORT.DIRCLR = BAT_EN_PIN;
-	BAT_EN_PORT.OUTCLR = BAT_EN_PIN;
+	BAT_EN::input();
+	BAT_EN::low();
 	// printf("battery: %.2f V\r\n", (double)battery_level);
-	if (battery_level < UVLO_VOLTS) {
-		set_uvlo();
-		set_brightness(0);
-	} else if (get_uvlo()) {
-		reset_uvlo();
-	}
+	record_delta(RECORD_BATTERY, (uint16_t)(battery_level * 1000), 20);
+	update_uvlo(battery_level);
 }
 
 static void check_battery_level() {
-	BAT_EN_PORT.DIRSET = BAT_EN_PIN;
-	BAT_EN_PORT.OUTSET = BAT_EN_PIN;
+	BAT_EN::output();
+	BAT_EN::high();
 	get_battery_level(battery_level_handler);
 }
 
+static volatile bool boot_battery_level_ready = false;
+static volatile float boot_battery_level = 0;
+
+static void boot_battery_level_handler(float battery_level) {
+	BAT_EN::input();
+	BAT_EN::low();
+	boot_battery_level = battery_level;
+	boot_battery_level_ready = true;
+}
+
+// Boot decisions run faster at 10 MHz, but only with enough supply for it
+static void scale_up_boot_clock() {
+	BAT_EN::output();
+	BAT_EN::high();
+	get_battery_level(boot_battery_level_handler);
+	while (!boot_battery_level_ready);
+	if (boot_battery_level >= CLOCK_10MHZ_MIN_VOLTS) {
+		set_cpu_clock(CLOCK_10MHZ);
+	}
+}
+
+// ===========================
+// ===== Flight Recorder =====
+// ===========================
+
+// 8.8 fixed-point log2, so one record per octave covers the whole range
+static uint16_t brightness_log2(brightness_t brightness) {
+	if (brightness == 0) {
+		return 0;
+	}
+	uint8_t exponent = 31;
+	while (!(brightness & 0x80000000UL)) {
+		brightness <<= 1;
+		exponent--;
+	}
+	return ((uint16_t)exponent << 8) | (uint8_t)(brightness >> 23);
+}
+
 // ================================
 // ===== Brightness Ramp Loop =====
 // ================================
 
-static void update_brightness() {
-	static const float MAX_TIME = 22;
-	static const uint16_t STEP_COUNT = 4096;
-	static const float TIME_STEP = MAX_TIME / STEP_COUNT;
-	static float t = 0;
-	static int8_t direction = 1;
-	float brightness_float = BRIGHTNESS_MAX * exp(t - MAX_TIME);
-	brightness_t brightness = 0;
-	if (brightness_float <= 0) {
-		brightness = 0;
-	} else if (brightness_float >= BRIGHTNESS_MAX) {
-		brightness = BRIGHTNESS_MAX;
-	} else {
-		brightness = (brightness_t)brightness_float;
+// Ramp position, saved for fast recovery
+static float t = 0;
+static int8_t direction = 1;
+
+static void report_ramp_transitions() {
+	BrightnessTransitions transitions = get_brightness_transitions();
+	printf("ramp transitions: group %u, vref %u, hdr %u\r\n", transitions.group, transitions.vref, transitions.hdr);
+	reset_brightness_transitions();
+}
+
+// ==============================
+// ===== Thermal Protection =====
+// ==============================
+
+// Cool-down before the comparator is re-armed
+static const uint16_t TRIP_COOLDOWN_MS = 5000;
+
+static bool trip_handled = false;
+static uint32_t rearm_deadline;
+
+static void check_protection() {
+	if (!is_tripped()) {
+		return;
 	}
-	set_brightness(brightness);
-	t += direction * TIME_STEP;
-	if (t >= 1.1f * MAX_TIME) {
-		direction = -1;
-	} else if (t <= 0) {
-		t = 0;
-		direction = 1;
+	if (!trip_handled) {
+		// EN is already low, bring the rest of the output state in line
+		trip_handled = true;
+		stop_strobe();
+		disable_boost();
+		record(RECORD_TRIP, 1);
+		printf("thermal trip\r\n");
+		dump_records();
+		rearm_deadline = deadline_in(TIMESTAMP_FROM_MS(TRIP_COOLDOWN_MS));
+	} else if (deadline_passed(rearm_deadline)) {
+		if (arm_protection()) {
+			trip_handled = false;
+		} else {
+			rearm_deadline = deadline_in(TIMESTAMP_FROM_MS(TRIP_COOLDOWN_MS));
+		}
 	}
 }
 
-typedef enum {
-	MODE_ULTRA_LOW = 0,
-	MODE_LOW,
-	MODE_HIGH,
-	MODE_ULTRA_HIGH,
-	MODE_RAMP_LOOP,
-	MODE_MAX,
-} mode_t;
-
-int main() {
-	// Enable global interrupts
-	sei();
+// =========================
+// ===== Boot/Recovery =====
+// =========================
 
-	// Check off-time
+static light_mode_t boot() {
+	// Check off-time first, click timing must not wait on anything else
 	check_off_time();
 	while (ADC1_is_converting());
 
+	// Stay on the 3.33 MHz reset clock until the cell is known to support 10 MHz
+	scale_up_boot_clock();
+
 	// Initialise
 	disable_boost();
 	disable_hdr();
 	USART0_init();
-	RTC_init();
 	DAC0_init();
 
+	uint8_t click_counter = load_click_counter();
+	return static_cast<light_mode_t>(click_counter % MODE_MAX);
+}
+
+static volatile bool vdd_ready = false;
+static volatile float vdd = 0;
+
+static void vdd_handler(float level) {
+	vdd = level;
+	vdd_ready = true;
+}
+
+static volatile bool dropout_time_ready = false;
+static volatile float dropout_time = 0;
+
+static void dropout_time_handler(float off_time) {
+	dropout_time = off_time;
+	dropout_time_ready = true;
+}
+
+// The off-time capacitor discharges while the BOD holds the MCU in reset
+static bool is_brief_dropout(uint8_t reset_flags) {
+	// Watchdog resets are immediate, VDD never dropped
+	if (!(reset_flags & RSTCTRL_BORF_bm)) {
+		return true;
+	}
+	// Read only, boot() reads it again and counts the click if this fails
+	OTC::input();
+	// OTC fell from the BOD level, which exceeds the 2.5V reference, so
+	// measure it against VDD and VDD against the 1.1V reference
+	get_vdd(vdd_handler);
+	while (!vdd_ready);
+	get_off_time_from(BOD_LEVEL_VOLTS, vdd, dropout_time_handler);
+	while (!dropout_time_ready);
+	return dropout_time <= RECOVERY_MAX_DROPOUT_SECONDS;
+}
+
+static uint8_t recovery_count = 0;
+
+static light_mode_t recover(const RecoveryState& state, uint32_t start) {
+	// Stays on the 3.33 MHz reset clock, in spec down to the BOD level
+	// unlike 10 MHz, while the restored load sags VDD again
+
+	// Dropout is not a click, skip EEPROM
+	// Recharge off-time capacitor for the next dropout or click
+	OTC::high();
+	OTC::output();
+
+	// A load that keeps causing dropouts must not be restored at full strength
+	light_mode_t mode = static_cast<light_mode_t>(state.mode % MODE_MAX);
+	recovery_count = state.recovery_count + 1;
+	bool step_down = recovery_count >= RECOVERY_STEP_DOWN_COUNT && mode != MODE_ULTRA_LOW && mode != MODE_LOW;
+
+	// Initialise, then restore output before anything else
+	disable_boost();
+	disable_hdr();
+	DAC0_init();
+	if (state.uvlo) {
+		// Stays off until the next battery reading clears it
+		set_uvlo();
+	}
+	if (step_down) {
+		mode = MODE_LOW;
+		apply_brightness_preset(MODE_PRESETS[MODE_LOW]);
+	} else {
+		t = state.ramp_t;
+		direction = state.ramp_direction;
+		set_brightness(state.brightness);
+	}
+
+	uint32_t recovery_us = timestamp_to_us(get_timestamp() - start);
+	record(RECORD_RECOVERY, recovery_us > UINT16_MAX ? UINT16_MAX : recovery_us);
+
+	USART0_init();
+	printf("recovered in %lu us from main(), %u in a row\r\n", recovery_us, recovery_count);
+	if (step_down) {
+		printf("stepped down to mode %u\r\n", mode);
+	}
+	return mode;
+}
+
+static void save_state(light_mode_t mode) {
+	RecoveryState state;
+	state.mode = mode;
+	state.brightness = get_brightness();
+	state.ramp_t = t;
+	state.ramp_direction = direction;
+	state.uvlo = get_uvlo();
+	state.recovery_count = recovery_count;
+	save_recovery_state(&state);
+}
+
+int main() {
+	// Start timebase first, recovery time is measured from here
+	RTC_init();
+	uint32_t start = get_timestamp();
+
+	// Read and clear reset cause
+	uint8_t reset_flags = RSTCTRL.RSTFR;
+	RSTCTRL.RSTFR = reset_flags;
+	RECORDER_init(reset_flags);
+
+	// Enable global interrupts
+	sei();
+
+	// Arm the comparator before any output can be restored
+	PROTECTION_init();
+
+	// Brief dropouts resume the previous output instead of booting
+	RecoveryState recovery_state;
+	light_mode_t mode;
+	if (load_recovery_state(reset_flags, &recovery_state) && is_brief_dropout(reset_flags)) {
+		mode = recover(recovery_state, start);
+	} else {
+		mode = boot();
+	}
+
 	// Enable external LED
-	LED_PORT.DIRSET = LED_PIN;
+	LED::output();
+
+	// Makes WDRF recovery possible, longer than the blocking record dump
+	_PROTECTED_WRITE(WDT.CTRLA, WDT_PERIOD_4KCLK_gc);
+
+	// Idle keeps TCA0 and the ADCs running
+	set_sleep_mode(SLEEP_MODE_IDLE);
 
-	uint8_t click_counter = load_click_counter();
-	mode_t mode = static_cast<mode_t>(click_counter % MODE_MAX);
 	printf("mode: %u\r\n", mode);
+	record(RECORD_MODE, mode);
+	printf("hdr gate skew: %u cycles (SBI/CBI pair)\r\n", HDR_GATE_SKEW_CYCLES);
+	reset_peripheral_current();
 
 	uint32_t blink_counter_prev = 0;
 	uint32_t check_counter_prev = 0;
+	uint32_t report_counter_prev = 0;
+	// History is dumped once the output is on, and again when UVLO turns it off
+	bool dump_pending = true;
+	bool uvlo_prev = false;
+
+	// Ramp timing is paced by the loop, everything else can run slow
+	set_cpu_clock(mode == MODE_RAMP_LOOP ? CLOCK_3MHZ33 : CLOCK_1MHZ25);
 
 	while (true) {
+		wdt_reset();
+
 		static const uint8_t COUNTER_FREQ_HZ = 8;
 		uint32_t counter = get_counter();
 
+		// Long enough without a dropout, later recoveries start counting again
+		if (recovery_count != 0 && counter >= RECOVERY_STABLE_SECONDS * COUNTER_FREQ_HZ) {
+			recovery_count = 0;
+		}
+
 		// Check temperatures and battery level
 		static const uint8_t UPDATE_FREQ_HZ = 8;
 		static const uint8_t UPDATE_COUNTER_PERIOD = COUNTER_FREQ_HZ / UPDATE_FREQ_HZ;
@@ -184,33 +379,45 @@ int main() {
 			check_counter_prev = counter;
 			check_temperatures();
 			check_battery_level();
+			record_delta(RECORD_BRIGHTNESS, brightness_log2(get_brightness()), 0x100);
+		}
+
+		// Report estimated average peripheral current for this mode
+		static const uint8_t REPORT_FREQ_HZ = 1;
+		static const uint8_t REPORT_COUNTER_PERIOD = COUNTER_FREQ_HZ / REPORT_FREQ_HZ;
+		if (counter - report_counter_prev >= REPORT_COUNTER_PERIOD) {
+			report_counter_prev = counter;
+			printf("mode %u peripherals: %.1f uA\r\n", mode, (double)get_peripheral_current_ua());
+			if (is_strobe_running()) {
+				printf("strobe: %u periods, jitter %u us, max %u Hz (ISR), %u Hz (LED settle design)\r\n", get_strobe_period_count(), get_strobe_jitter_us(), get_strobe_max_frequency_hz(), 1000 / (2 * STROBE_MIN_ON_TIME_MS));
+			}
 		}
 
-		switch (mode) {
-		case MODE_ULTRA_LOW:
-		case MODE_MAX:
-			set_brightness(1);
-			break;
-		case MODE_LOW:
-			set_brightness(4e5);
-			break;
-		case MODE_HIGH:
-			set_brightness(15e6);
-			break;
-		case MODE_ULTRA_HIGH:
-			set_brightness(BRIGHTNESS_MAX);
-			break;
-		case MODE_RAMP_LOOP:
-			update_brightness();
-			break;
+		check_protection();
+
+		if (update_mode(mode, t, direction)) {
+			report_ramp_transitions();
+		}
+		save_state(mode);
+
+		bool uvlo = get_uvlo();
+		if (dump_pending || (uvlo && !uvlo_prev)) {
+			dump_pending = false;
+			dump_records();
 		}
+		uvlo_prev = uvlo;
 
 		// Toggle LED at 2 Hz if normal, 1 Hz if UVLO
 		static const uint8_t BLINK_FREQ_HZ = 2;
 		static const uint8_t BLINK_COUNTER_PERIOD = COUNTER_FREQ_HZ / BLINK_FREQ_HZ;
 		if (counter - blink_counter_prev >= (get_uvlo() ? (2 * BLINK_COUNTER_PERIOD) : BLINK_COUNTER_PERIOD)) {
 			blink_counter_prev = counter;
-			LED_PORT.OUTTGL = LED_PIN;
+			LED::toggle();
+		}
+
+		// Strobe output runs from TCA0, idle until the next interrupt
+		if (is_strobe_running()) {
+			sleep_mode();
 		}
 	}
 
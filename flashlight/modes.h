@@ -0,0 +1,127 @@
+#ifndef MODES_H_
+#define MODES_H_
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "brightness.h"
+extern "C" {
+#include "control.h"
+#include "strobe.h"
+}
+
+/*
+Mode levels, ramp, strobe and UVLO decisions, through the control, brightness
+and strobe APIs only. Shared by main.cpp and the host runtime simulator in
+sim/, which provides its own control and strobe implementations.
+*/
+
+#ifndef UVLO_VOLTS
+#define UVLO_VOLTS 3
+#endif
+
+typedef enum {
+	MODE_ULTRA_LOW = 0,
+	MODE_LOW,
+	MODE_HIGH,
+	MODE_ULTRA_HIGH,
+	MODE_RAMP_LOOP,
+	MODE_STROBE,
+	MODE_BEACON,
+	MODE_MAX,
+} light_mode_t;
+
+// Fixed levels, resolved to DAC, VREF and HDR settings at compile time
+static constexpr BrightnessPreset MODE_PRESETS[] = {
+	make_brightness_preset(1), // MODE_ULTRA_LOW
+	make_brightness_preset(4e5), // MODE_LOW
+	make_brightness_preset(15e6), // MODE_HIGH
+	make_brightness_preset(BRIGHTNESS_MAX), // MODE_ULTRA_HIGH
+};
+static_assert(sizeof(MODE_PRESETS) / sizeof(BrightnessPreset) == MODE_RAMP_LOOP, "Missing mode preset");
+
+static constexpr BrightnessPreset STROBE_PRESET = make_brightness_preset(BRIGHTNESS_MAX);
+
+// 10 Hz, 50% duty
+#define STROBE_PERIOD_MS 100
+#define STROBE_ON_TIME_MS 50
+// 1 Hz, 50 ms flash
+#define BEACON_PERIOD_MS 1000
+#define BEACON_ON_TIME_MS 50
+
+static const float RAMP_MAX_TIME = 22;
+static const uint16_t RAMP_STEP_COUNT = 4096;
+static const float RAMP_TIME_STEP = RAMP_MAX_TIME / RAMP_STEP_COUNT;
+
+inline brightness_t ramp_brightness(float t) {
+	float brightness_float = BRIGHTNESS_MAX * exp(t - RAMP_MAX_TIME);
+	if (brightness_float <= 0) {
+		return 0;
+	} else if (brightness_float >= BRIGHTNESS_MAX) {
+		return BRIGHTNESS_MAX;
+	}
+	return (brightness_t)brightness_float;
+}
+
+// One ramp step per call, returns true when a full up/down cycle is complete
+inline bool ramp_step(float& t, int8_t& direction) {
+	t += direction * RAMP_TIME_STEP;
+	if (t >= 1.1f * RAMP_MAX_TIME) {
+		direction = -1;
+	} else if (t <= 0) {
+		t = 0;
+		direction = 1;
+		return true;
+	}
+	return false;
+}
+
+inline void update_strobe(light_mode_t mode) {
+	apply_brightness_preset(STROBE_PRESET);
+	// Strobe only gates the DAC, UVLO still has to turn it off
+	if (get_boost_state() != ENABLED) {
+		stop_strobe();
+	} else if (!is_strobe_running()) {
+		if (mode == MODE_STROBE) {
+			start_strobe(STROBE_PERIOD_MS, STROBE_ON_TIME_MS);
+		} else {
+			start_strobe(BEACON_PERIOD_MS, BEACON_ON_TIME_MS);
+		}
+	}
+}
+
+// Output for one main loop pass, returns true when a ramp cycle is complete
+inline bool update_mode(light_mode_t mode, float& ramp_t, int8_t& ramp_direction) {
+	switch (mode) {
+	case MODE_ULTRA_LOW:
+	case MODE_LOW:
+	case MODE_HIGH:
+	case MODE_ULTRA_HIGH:
+		apply_brightness_preset(MODE_PRESETS[mode]);
+		break;
+	case MODE_MAX:
+		apply_brightness_preset(MODE_PRESETS[MODE_ULTRA_LOW]);
+		break;
+	case MODE_RAMP_LOOP:
+		set_brightness(ramp_brightness(ramp_t));
+		return ramp_step(ramp_t, ramp_direction);
+	case MODE_STROBE:
+	case MODE_BEACON:
+		update_strobe(mode);
+		break;
+	}
+	return false;
+}
+
+// Called with every battery level reading
+inline void update_uvlo(float battery_level) {
+	if (battery_level < UVLO_VOLTS) {
+		set_uvlo();
+		set_brightness(0);
+	} else if (get_uvlo()) {
+		reset_uvlo();
+	}
+}
+
+#endif /* MODES_H_ */
\ No newline at end of file
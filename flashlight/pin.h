@@ -0,0 +1,116 @@
+#ifndef PIN_H_
+#define PIN_H_
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <util/atomic.h>
+
+/*
+Compile-time pin access through the virtual port (VPORT) registers.
+VPORTs sit at the bottom of the I/O space, so a single-bit write with a
+constant mask compiles to SBI/CBI (1 cycle on AVRxt) instead of LDI + STS
+to PORTx.DIRSET/OUTSET.
+*/
+
+enum class Port : uint8_t {
+	A,
+	B,
+	C,
+};
+
+// addr is the I/O address of VPORTx.DIR, usable as an SBI/CBI operand in inline asm
+template <Port P>
+struct VPort;
+
+template <>
+struct VPort<Port::A> {
+	static constexpr uint8_t addr = 0x00;
+	static volatile uint8_t& dir() { return VPORTA.DIR; }
+	static volatile uint8_t& out() { return VPORTA.OUT; }
+	static volatile uint8_t& in() { return VPORTA.IN; }
+};
+
+template <>
+struct VPort<Port::B> {
+	static constexpr uint8_t addr = 0x04;
+	static volatile uint8_t& dir() { return VPORTB.DIR; }
+	static volatile uint8_t& out() { return VPORTB.OUT; }
+	static volatile uint8_t& in() { return VPORTB.IN; }
+};
+
+template <>
+struct VPort<Port::C> {
+	static constexpr uint8_t addr = 0x08;
+	static volatile uint8_t& dir() { return VPORTC.DIR; }
+	static volatile uint8_t& out() { return VPORTC.OUT; }
+	static volatile uint8_t& in() { return VPORTC.IN; }
+};
+
+template <Port P, uint8_t Bit>
+struct Pin {
+	static_assert(Bit < 8, "Pin bit out of range");
+
+	static constexpr Port port = P;
+	static constexpr uint8_t bit = Bit;
+	static constexpr uint8_t mask = 1 << Bit;
+	// VPORT_t is DIR, OUT, IN, INTFLAGS
+	static constexpr uint8_t dir_addr = VPort<P>::addr;
+	static constexpr uint8_t out_addr = VPort<P>::addr + 1;
+
+	static void output() { VPort<P>::dir() |= mask; }
+	static void input() { VPort<P>::dir() &= (uint8_t)~mask; }
+	static void high() { VPort<P>::out() |= mask; }
+	static void low() { VPort<P>::out() &= (uint8_t)~mask; }
+	// Writing 1 to VPORT.IN toggles OUT, a read-modify-write would toggle every high pin
+	static void toggle() { VPort<P>::in() = mask; }
+};
+
+template <typename... Pins>
+struct PinMask;
+
+template <>
+struct PinMask<> {
+	static constexpr uint8_t value = 0;
+};
+
+template <typename First, typename... Rest>
+struct PinMask<First, Rest...> {
+	static constexpr uint8_t value = First::mask | PinMask<Rest...>::value;
+};
+
+template <Port P>
+constexpr bool pins_on_port() {
+	return true;
+}
+
+template <Port P, typename First, typename... Rest>
+constexpr bool pins_on_port() {
+	return First::port == P && pins_on_port<P, Rest...>();
+}
+
+/*
+Several pins on one port, switched by a single masked write so that all edges
+land on the same cycle. Multi-bit writes are read-modify-write, so they are
+made atomic against ISRs touching the same port.
+*/
+template <typename First, typename... Rest>
+struct PinGroup {
+	static_assert(pins_on_port<First::port, Rest...>(), "PinGroup pins must share a port");
+
+	static constexpr Port port = First::port;
+	static constexpr uint8_t mask = PinMask<First, Rest...>::value;
+
+	static void output() {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			VPort<port>::dir() |= mask;
+		}
+	}
+	static void input() {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			VPort<port>::dir() &= (uint8_t)~mask;
+		}
+	}
+};
+
+#endif /* PIN_H_ */
\ No newline at end of file
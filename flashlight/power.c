@@ -0,0 +1,135 @@
+#include <avr/io.h>
+#include <stdint.h>
+#include <util/atomic.h>
+
+#include "power.h"
+#include "rtc.h"
+
+/*
+ADCs: started by the first conversion request, stopped once its result is read.
+ADC_INITDLY covers the VREF start-up time, so no explicit wait is needed.
+VREFs: force enabled while counted, the requesting peripheral also keeps them
+running while it is enabled.
+DAC0: acquired by enable_boost(), released by disable_boost().
+*/
+
+// Typical supply current when enabled, approximate, calibrate on the bench
+static const float PERIPHERAL_CURRENT_UA[PERIPHERAL_MAX] = {
+	[PERIPHERAL_ADC0] = 325.0f,
+	[PERIPHERAL_ADC1] = 325.0f,
+	[PERIPHERAL_DAC0] = 100.0f,
+	[PERIPHERAL_VREF_ADC0] = 10.0f,
+	[PERIPHERAL_VREF_ADC1] = 10.0f,
+	[PERIPHERAL_VREF_DAC0] = 10.0f,
+};
+
+static uint8_t ref_count[PERIPHERAL_MAX];
+static uint32_t enabled_since[PERIPHERAL_MAX];
+static uint32_t enabled_ticks[PERIPHERAL_MAX];
+static uint32_t stats_since = 0;
+
+static void set_enabled(peripheral_t peripheral, bool enable) {
+	switch (peripheral) {
+	case PERIPHERAL_ADC0:
+		if (enable) {
+			ADC0.CTRLA |= ADC_ENABLE_bm;
+		} else {
+			ADC0.CTRLA &= ~ADC_ENABLE_bm;
+		}
+		break;
+	case PERIPHERAL_ADC1:
+		if (enable) {
+			ADC1.CTRLA |= ADC_ENABLE_bm;
+		} else {
+			ADC1.CTRLA &= ~ADC_ENABLE_bm;
+		}
+		break;
+	case PERIPHERAL_DAC0:
+		if (enable) {
+			DAC0.CTRLA = DAC_ENABLE_bm | DAC_OUTEN_bm;
+		} else {
+			DAC0.CTRLA = 0;
+		}
+		break;
+	case PERIPHERAL_VREF_ADC0:
+		if (enable) {
+			VREF.CTRLB |= VREF_ADC0REFEN_bm;
+		} else {
+			VREF.CTRLB &= ~VREF_ADC0REFEN_bm;
+		}
+		break;
+	case PERIPHERAL_VREF_ADC1:
+		if (enable) {
+			VREF.CTRLB |= VREF_ADC1REFEN_bm;
+		} else {
+			VREF.CTRLB &= ~VREF_ADC1REFEN_bm;
+		}
+		break;
+	case PERIPHERAL_VREF_DAC0:
+		if (enable) {
+			VREF.CTRLB |= VREF_DAC0REFEN_bm;
+		} else {
+			VREF.CTRLB &= ~VREF_DAC0REFEN_bm;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void acquire_peripheral(peripheral_t peripheral) {
+	// Also called from ADC interrupts
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (ref_count[peripheral]++ == 0) {
+			enabled_since[peripheral] = get_timestamp();
+			set_enabled(peripheral, true);
+		}
+	}
+}
+
+void release_peripheral(peripheral_t peripheral) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (ref_count[peripheral] == 0) {
+			return;
+		}
+		if (--ref_count[peripheral] == 0) {
+			set_enabled(peripheral, false);
+			enabled_ticks[peripheral] += get_timestamp() - enabled_since[peripheral];
+		}
+	}
+}
+
+void reset_peripheral_current() {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		stats_since = get_timestamp();
+		for (uint8_t i = 0; i < PERIPHERAL_MAX; i++) {
+			enabled_since[i] = stats_since;
+			enabled_ticks[i] = 0;
+		}
+	}
+}
+
+float get_peripheral_current_ua() {
+	// Snapshot with interrupts off, float math can take a millisecond at low clocks
+	uint32_t ticks[PERIPHERAL_MAX];
+	uint32_t elapsed;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		uint32_t now = get_timestamp();
+		elapsed = now - stats_since;
+		for (uint8_t i = 0; i < PERIPHERAL_MAX; i++) {
+			ticks[i] = enabled_ticks[i];
+			// Include the time a peripheral has been on so far
+			if (ref_count[i] != 0) {
+				ticks[i] += now - enabled_since[i];
+			}
+		}
+	}
+	if (elapsed == 0) {
+		return 0;
+	}
+	float current = 0;
+	for (uint8_t i = 0; i < PERIPHERAL_MAX; i++) {
+		current += PERIPHERAL_CURRENT_UA[i] * ticks[i] / elapsed;
+	}
+	return current;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdbool.h>
+
+typedef enum {
+	PERIPHERAL_ADC0,
+	PERIPHERAL_ADC1,
+	PERIPHERAL_DAC0,
+	PERIPHERAL_VREF_ADC0,
+	PERIPHERAL_VREF_ADC1,
+	PERIPHERAL_VREF_DAC0,
+	PERIPHERAL_MAX,
+} peripheral_t;
+
+// Reference counted, peripheral is enabled while count is non-zero
+void acquire_peripheral(peripheral_t peripheral);
+void release_peripheral(peripheral_t peripheral);
+
+// Estimated average peripheral current since the last reset of the statistics
+void reset_peripheral_current();
+float get_peripheral_current_ua();
+
+#endif /* POWER_H_ */
\ No newline at end of file
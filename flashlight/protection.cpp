@@ -0,0 +1,99 @@
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "protection.h"
+extern "C" {
+#include "clock.h"
+}
+
+/*
+NTC: PB4 (AC0 AINN1, shared with ADC0 AIN9 for get_ntc_temperature())
+TRIP: PB1 (AC0 AINP2, hardware hacked, VCC divider setting the trip point)
+EN: PA7 (LUT1-OUT, AC0 output gated by the CCL enable)
+
+AC0 positive inputs are pins only, and AC0's VREF is DAC0REFSEL, which the
+brightness groups keep changing, so the threshold comes from a divider.
+Both sides are ratiometric to VCC like the NTC itself, e.g. 18k to VCC and
+82k to GND trips at 0.82 VCC, about 70 C with the 10k/B3428 NTC over 10k.
+Output is high while cool.
+
+The cut is all hardware: AC0 output falls, LUT1 output and EN follow. That is
+AC0 propagation (150 ns typical per datasheet, not measured) plus a few ns
+through the CCL, independent of the CPU clock and of sleep. The interrupt
+only latches the trip, so EN stays low once the comparator recovers.
+*/
+
+#if USE_THERMAL_TRIP
+
+// Well above the AC start-up time, STATE is not valid before it
+#define AC_STARTUP_DELAY_MS 1
+
+static volatile bool tripped = false;
+
+void PROTECTION_init() {
+	// Analog only, disable digital input buffers
+	PORTB.PIN4CTRL = PORT_ISC_INPUT_DISABLE_gc;
+	PORTB.PIN1CTRL = PORT_ISC_INPUT_DISABLE_gc;
+	AC0.MUXCTRLA = AC_MUXPOS_PIN2_gc | AC_MUXNEG_PIN1_gc;
+	AC0.CTRLA = AC_INTMODE_NEGEDGE_gc | AC_HYSMODE_50mV_gc | AC_ENABLE_bm;
+
+	// LUT1 passes AC0 to EN, configured while the CCL is off
+	CCL.CTRLA = 0;
+	CCL.LUT1CTRLB = CCL_INSEL0_AC0_gc | CCL_INSEL1_MASK_gc;
+	CCL.LUT1CTRLC = CCL_INSEL2_MASK_gc;
+	CCL.TRUTH1 = 0x02;
+	CCL.LUT1CTRLA = CCL_OUTEN_bm | CCL_ENABLE_bm;
+
+	// A cold boot must not read a settling comparator as tripped
+	delay_ms(AC_STARTUP_DELAY_MS);
+	arm_protection();
+}
+
+void connect_en_gate() {
+	CCL.CTRLA = CCL_ENABLE_bm;
+}
+
+void disconnect_en_gate() {
+	// EN falls back to its PORT output, which is low
+	CCL.CTRLA = 0;
+}
+
+ISR(AC0_AC_vect) {
+	// EN is already low through LUT1, keep it there
+	CCL.CTRLA = 0;
+	AC0.INTCTRL = 0;
+	AC0.STATUS = AC_CMP_bm;
+	tripped = true;
+}
+
+bool is_tripped() {
+	return tripped;
+}
+
+bool arm_protection() {
+	AC0.STATUS = AC_CMP_bm;
+	// Already past the threshold, an edge would never come
+	if (!(AC0.STATUS & AC_STATE_bm)) {
+		disconnect_en_gate();
+		tripped = true;
+		return false;
+	}
+	tripped = false;
+	AC0.INTCTRL = AC_CMP_bm;
+	return true;
+}
+
+#else
+
+void PROTECTION_init() {
+}
+
+bool is_tripped() {
+	return false;
+}
+
+bool arm_protection() {
+	return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef PROTECTION_H_
+#define PROTECTION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Needs the PB1 threshold divider, see README.md. Without it PB1 floats, can
+// read hot at boot and would keep the light off.
+#define USE_THERMAL_TRIP 0
+
+void PROTECTION_init();
+// Tripped protection has cut EN and blocks enable_boost() until re-armed
+bool is_tripped();
+// Only re-arms once the comparator is back below its threshold
+bool arm_protection();
+
+// EN = boost request AND AC0 output through CCL LUT1, the PORT output stays low
+void connect_en_gate();
+void disconnect_en_gate();
+
+#endif /* PROTECTION_H_ */
\ No newline at end of file
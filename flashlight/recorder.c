@@ -0,0 +1,103 @@
+#include <avr/io.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <util/atomic.h>
+
+#include "recorder.h"
+#include "rtc.h"
+
+// Must be a power of two, 5 bytes per record
+#define RECORD_COUNT 64
+#define RECORDER_MAGIC 0xF17E
+
+typedef struct {
+	uint16_t time; // 8 Hz counter since boot, low 16 bits
+	uint8_t type;
+	uint16_t value;
+} Record;
+
+typedef struct {
+	uint16_t magic;
+	uint16_t magic_inverse;
+	uint8_t head;
+	uint8_t count;
+	Record records[RECORD_COUNT];
+} Recorder;
+
+static Recorder recorder __attribute__((section(".noinit")));
+
+static uint16_t last_value[RECORD_TYPE_MAX];
+static bool has_last_value[RECORD_TYPE_MAX];
+
+static const char *const RECORD_NAMES[RECORD_TYPE_MAX] = {
+	[RECORD_RESET] = "reset",
+	[RECORD_MODE] = "mode",
+	[RECORD_BATTERY] = "battery",
+	[RECORD_NTC_TEMPERATURE] = "ntc",
+	[RECORD_INTERNAL_TEMPERATURE] = "internal",
+	[RECORD_BRIGHTNESS] = "brightness",
+	[RECORD_BOOST] = "boost",
+	[RECORD_HDR] = "hdr",
+	[RECORD_UVLO] = "uvlo",
+	[RECORD_RECOVERY] = "recovery",
+	[RECORD_TRIP] = "trip",
+};
+
+void RECORDER_init(uint8_t reset_flags) {
+	// SRAM usually survives the short power cycle after a UVLO or thermal shutdown,
+	// so a power-on reset only clears the buffer if it no longer checks out
+	if (recorder.magic != RECORDER_MAGIC
+		|| recorder.magic_inverse != (uint16_t)~RECORDER_MAGIC
+		|| recorder.head >= RECORD_COUNT
+		|| recorder.count > RECORD_COUNT) {
+		recorder.magic = RECORDER_MAGIC;
+		recorder.magic_inverse = (uint16_t)~RECORDER_MAGIC;
+		recorder.head = 0;
+		recorder.count = 0;
+	}
+	record(RECORD_RESET, reset_flags);
+}
+
+void record(record_type_t type, uint16_t value) {
+	// Also called from ADC interrupts
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		Record *r = &recorder.records[recorder.head];
+		recorder.head = (recorder.head + 1) & (RECORD_COUNT - 1);
+		if (recorder.count < RECORD_COUNT) {
+			recorder.count++;
+		}
+		r->time = (uint16_t)get_counter();
+		r->type = type;
+		r->value = value;
+	}
+}
+
+void record_delta(record_type_t type, uint16_t value, uint16_t min_delta) {
+	if (has_last_value[type]) {
+		int16_t delta = (int16_t)(value - last_value[type]);
+		if (delta < 0) {
+			delta = -delta;
+		}
+		if ((uint16_t)delta < min_delta) {
+			return;
+		}
+	}
+	last_value[type] = value;
+	has_last_value[type] = true;
+	record(type, value);
+}
+
+void dump_records() {
+	printf("records: %u\r\n", recorder.count);
+	uint8_t index = (recorder.head - recorder.count) & (RECORD_COUNT - 1);
+	for (uint8_t i = 0; i < recorder.count; i++) {
+		const Record *r = &recorder.records[index];
+		const char *name = r->type < RECORD_TYPE_MAX ? RECORD_NAMES[r->type] : "?";
+		if (r->type == RECORD_NTC_TEMPERATURE || r->type == RECORD_INTERNAL_TEMPERATURE) {
+			printf("%5u %s %d\r\n", r->time, name, (int16_t)r->value);
+		} else {
+			printf("%5u %s %u\r\n", r->time, name, r->value);
+		}
+		index = (index + 1) & (RECORD_COUNT - 1);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <stdint.h>
+
+typedef enum {
+	RECORD_RESET, // RSTCTRL.RSTFR
+	RECORD_MODE,
+	RECORD_BATTERY, // mV
+	RECORD_NTC_TEMPERATURE, // Signed, 0.01 C
+	RECORD_INTERNAL_TEMPERATURE, // Signed, 0.01 C
+	RECORD_BRIGHTNESS, // 8.8 fixed-point log2
+	RECORD_BOOST, // state_t
+	RECORD_HDR, // state_t
+	RECORD_UVLO, // 1 if set
+	RECORD_RECOVERY, // us from the top of main() to restored output
+	RECORD_TRIP, // 1 when tripped
+	RECORD_TYPE_MAX,
+} record_type_t;
+
+// Buffer lives in .noinit and is only cleared when it fails validation
+void RECORDER_init(uint8_t reset_flags);
+void record(record_type_t type, uint16_t value);
+// Skips the record unless value moved by at least min_delta since the last one
+void record_delta(record_type_t type, uint16_t value, uint16_t min_delta);
+// Prints records oldest first through stdout
+void dump_records();
+
+#endif /* RECORDER_H_ */
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <avr/io.h>
+
+#include "recovery.h"
+
+/*
+Saved state lives in .noinit and survives any reset that keeps SRAM powered.
+A BOD reset without PORF means VDD never fell below the POR threshold, so the
+dropout may have been brief and the light should come straight back. The BOD
+can hold the MCU in reset for any time, so main.cpp checks the off-time
+capacitor before recovering. OTC is driven to VDD until the reset, so it
+starts decaying from the BOD level rather than the diode clamp that
+get_off_time() assumes after a power cycle.
+
+BORF needs the BOD enabled by fuse (BODCFG, see flash.bat and README.md),
+WDRF needs the watchdog main() enables.
+*/
+
+#define RECOVERY_MAGIC 0x5AFE
+#define RECOVERY_RESET_FLAGS (RSTCTRL_BORF_bm | RSTCTRL_WDRF_bm)
+
+typedef struct {
+	uint16_t magic;
+	RecoveryState state;
+	uint8_t checksum;
+} SavedState;
+
+static SavedState saved __attribute__((section(".noinit")));
+
+static uint8_t checksum(const RecoveryState *state) {
+	const uint8_t *bytes = (const uint8_t *)state;
+	uint8_t sum = 0;
+	for (uint8_t i = 0; i < sizeof(RecoveryState); i++) {
+		// Rotate so swapped bytes are caught as well
+		sum = ((sum << 1) | (sum >> 7)) ^ bytes[i];
+	}
+	return sum;
+}
+
+bool load_recovery_state(uint8_t reset_flags, RecoveryState *state) {
+	bool valid = saved.magic == RECOVERY_MAGIC && saved.checksum == checksum(&saved.state);
+	if (!valid || (reset_flags & RSTCTRL_PORF_bm) || !(reset_flags & RECOVERY_RESET_FLAGS)) {
+		// Normal boot, stale state must not be restored later
+		saved.magic = 0;
+		return false;
+	}
+	*state = saved.state;
+	return true;
+}
+
+void save_recovery_state(const RecoveryState *state) {
+	saved.state = *state;
+	saved.checksum = checksum(state);
+	saved.magic = RECOVERY_MAGIC;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef RECOVERY_H_
+#define RECOVERY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// BOD falling threshold from BODCFG 0x45 (flash.bat), VDD when the BOD reset starts
+#define BOD_LEVEL_VOLTS 2.6f
+
+// Output state needed to resume after a brief supply dropout
+typedef struct {
+	uint8_t mode;
+	uint32_t brightness;
+	float ramp_t;
+	int8_t ramp_direction;
+	bool uvlo;
+	// Recoveries without a stable run in between
+	uint8_t recovery_count;
+} RecoveryState;
+
+// True after a BOD or watchdog reset without power-on reset, with a valid saved state
+// Otherwise the saved state is invalidated
+bool load_recovery_state(uint8_t reset_flags, RecoveryState *state);
+void save_recovery_state(const RecoveryState *state);
+
+#endif /* RECOVERY_H_ */
\ No newline at end of file
@@ -1,25 +1,67 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <util/atomic.h>
 
 #include "rtc.h"
 
+// Counter overflows every 4096 RTC cycles (8 Hz)
+#define RTC_PERIOD_BITS 12
+#define RTC_PERIOD (1U << RTC_PERIOD_BITS)
+
 void RTC_init() {
 	// Select clock
 	RTC.CLKSEL &= ~RTC_CLKSEL_gm;
 	RTC.CLKSEL |= RTC_CLKSEL_INT32K_gc;
+	// Set period
+	while (RTC.STATUS & RTC_PERBUSY_bm);
+	RTC.PER = RTC_PERIOD - 1;
 	// Enable interrupt
-	RTC.PITINTCTRL |= RTC_PI_bm;
-	// Set period and enable
-	RTC.PITCTRLA |= RTC_PERIOD_CYC4096_gc | RTC_PITEN_bm;
+	RTC.INTCTRL |= RTC_OVF_bm;
+	// Enable without prescaler, CNT then resolves single RTC cycles
+	while (RTC.STATUS & RTC_CTRLABUSY_bm);
+	RTC.CTRLA = RTC_PRESCALER_DIV1_gc | RTC_RTCEN_bm;
 }
 
 static volatile uint32_t counter = 0;
 
-ISR(RTC_PIT_vect) {
-	RTC.PITINTFLAGS = 1;
+ISR(RTC_CNT_vect) {
+	RTC.INTFLAGS = RTC_OVF_bm;
 	counter++;
 }
 
 uint32_t get_counter() {
-	return counter;
+	uint32_t value;
+	// 32-bit read would tear if the ISR fires midway
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		value = counter;
+	}
+	return value;
+}
+
+uint32_t get_timestamp() {
+	uint32_t ticks;
+	uint16_t cnt;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ticks = counter;
+		cnt = RTC.CNT;
+		// CNT already wrapped but the ISR has not run yet
+		if ((RTC.INTFLAGS & RTC_OVF_bm) && cnt < RTC_PERIOD / 2) {
+			ticks++;
+		}
+	}
+	return (ticks << RTC_PERIOD_BITS) | cnt;
+}
+
+uint32_t timestamp_to_us(uint32_t timestamp) {
+	// 1e6 / 32768 = 15625 / 512, split to stay within 32 bits
+	return (timestamp >> 9) * 15625 + (((timestamp & 0x1FF) * 15625) >> 9);
+}
+
+uint32_t deadline_in(uint32_t ticks) {
+	return get_timestamp() + ticks;
+}
+
+bool deadline_passed(uint32_t deadline) {
+	// Signed difference stays correct across wrap-around
+	return (int32_t)(get_timestamp() - deadline) >= 0;
 }
\ No newline at end of file
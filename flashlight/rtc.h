@@ -1,9 +1,20 @@
 #ifndef RTC_H_
 #define RTC_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
+// Timestamps count 32.768 kHz RTC cycles and wrap after ~36 hours
+#define TIMESTAMP_FREQ_HZ 32768UL
+#define TIMESTAMP_FROM_MS(ms) ((uint32_t)((ms) * TIMESTAMP_FREQ_HZ / 1000))
+
 void RTC_init();
 uint32_t get_counter();
+uint32_t get_timestamp();
+uint32_t timestamp_to_us(uint32_t timestamp);
+
+// Deadlines must lie less than 2^31 ticks (~18 hours) ahead
+uint32_t deadline_in(uint32_t ticks);
+bool deadline_passed(uint32_t deadline);
 
 #endif /* RTC_H_ */
\ No newline at end of file
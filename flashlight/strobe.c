@@ -0,0 +1,202 @@
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "clock.h"
+#include "strobe.h"
+
+/*
+DAC0: switched between the strobe level and 0 from the TCA0 interrupt
+TCA0: OVF ends each phase, PERBUF holds the length of the phase after it
+
+OVF is the only strobe vector and runs at interrupt level 1, so it pre-empts
+level 0 handlers, e.g. ADC callbacks printing at 9600 baud.
+
+EN stays high, so the MP3432 keeps running and starts only once, through
+enable_boost() and its flash fix. Gating EN instead restarted it on every
+flash without the fix.
+*/
+
+typedef struct {
+	uint8_t clksel;
+	uint16_t div;
+} TimerPrescaler;
+
+static const TimerPrescaler PRESCALERS[] = {
+	{ .clksel = TCA_SINGLE_CLKSEL_DIV1_gc, .div = 1 },
+	{ .clksel = TCA_SINGLE_CLKSEL_DIV2_gc, .div = 2 },
+	{ .clksel = TCA_SINGLE_CLKSEL_DIV4_gc, .div = 4 },
+	{ .clksel = TCA_SINGLE_CLKSEL_DIV8_gc, .div = 8 },
+	{ .clksel = TCA_SINGLE_CLKSEL_DIV16_gc, .div = 16 },
+	{ .clksel = TCA_SINGLE_CLKSEL_DIV64_gc, .div = 64 },
+	{ .clksel = TCA_SINGLE_CLKSEL_DIV256_gc, .div = 256 },
+	{ .clksel = TCA_SINGLE_CLKSEL_DIV1024_gc, .div = 1024 },
+};
+
+static const uint8_t PRESCALERS_SIZE = sizeof(PRESCALERS) / sizeof(TimerPrescaler);
+
+static bool running = false;
+static uint16_t strobe_period_ms = 0;
+static uint16_t strobe_on_time_ms = 0;
+
+static volatile uint8_t dac_on_value = 0;
+static volatile bool on_phase = false;
+static volatile uint16_t on_ticks = 0;
+static volatile uint16_t off_ticks = 0;
+static uint32_t timer_hz = 0;
+
+// TCA0 ticks after the OVF, so relative to the ideal edge
+static volatile uint16_t write_delay_min = 0xFFFF;
+static volatile uint16_t write_delay_max = 0;
+static volatile uint16_t handled_max = 0;
+static volatile uint16_t period_count = 0;
+
+static void reset_measurement() {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		write_delay_min = 0xFFFF;
+		write_delay_max = 0;
+		handled_max = 0;
+		period_count = 0;
+	}
+}
+
+static void configure_timer() {
+	// No OVF while the 16-bit registers are written through TEMP
+	TCA0.SINGLE.INTCTRL = 0;
+	TCA0.SINGLE.CTRLA = 0;
+
+	// Pick the finest prescaler that still fits the period in 16 bits
+	uint8_t i = 0;
+	float ticks_per_ms = 0;
+	for (; i < PRESCALERS_SIZE; i++) {
+		ticks_per_ms = (float)get_f_cpu() / PRESCALERS[i].div / 1000;
+		if (ticks_per_ms * strobe_period_ms <= 65536.0f) {
+			break;
+		}
+	}
+	if (i == PRESCALERS_SIZE) {
+		i = PRESCALERS_SIZE - 1;
+	}
+	uint32_t period = ticks_per_ms * strobe_period_ms;
+	if (period > 65536) {
+		period = 65536;
+	}
+	uint32_t on = ticks_per_ms * strobe_on_time_ms;
+	if (on < 1) {
+		on = 1;
+	}
+	if (on > period - 1) {
+		on = period - 1;
+	}
+	on_ticks = on;
+	off_ticks = period - on;
+	timer_hz = get_f_cpu() / PRESCALERS[i].div;
+
+	// Restart in the on-phase, the next phase is already buffered
+	DAC0.DATA = dac_on_value;
+	on_phase = true;
+	TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_NORMAL_gc;
+	TCA0.SINGLE.PER = on_ticks - 1;
+	TCA0.SINGLE.PERBUF = off_ticks - 1;
+	TCA0.SINGLE.CNT = 0;
+	TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+	TCA0.SINGLE.INTCTRL = TCA_SINGLE_OVF_bm;
+	TCA0.SINGLE.CTRLA = PRESCALERS[i].clksel | TCA_SINGLE_ENABLE_bm;
+
+	reset_measurement();
+}
+
+void start_strobe(uint16_t period_ms, uint16_t on_time_ms) {
+	if (on_time_ms < STROBE_MIN_ON_TIME_MS) {
+		on_time_ms = STROBE_MIN_ON_TIME_MS;
+	}
+	if (period_ms < on_time_ms + STROBE_MIN_ON_TIME_MS) {
+		period_ms = on_time_ms + STROBE_MIN_ON_TIME_MS;
+	}
+	strobe_period_ms = period_ms;
+	strobe_on_time_ms = on_time_ms;
+
+	// The output is already at the strobe level
+	dac_on_value = DAC0.DATA;
+	CPUINT.LVL1VEC = TCA0_OVF_vect_num;
+	configure_timer();
+	running = true;
+}
+
+void stop_strobe() {
+	if (!running) {
+		return;
+	}
+	TCA0.SINGLE.CTRLA = 0;
+	TCA0.SINGLE.INTCTRL = 0;
+	CPUINT.LVL1VEC = 0;
+	// Leave the DAC where brightness.cpp last put it
+	DAC0.DATA = dac_on_value;
+	running = false;
+}
+
+bool is_strobe_running() {
+	return running;
+}
+
+void update_strobe_clock() {
+	if (running) {
+		configure_timer();
+	}
+}
+
+ISR(TCA0_OVF_vect) {
+	// Edge first, everything else is measurement
+	on_phase = !on_phase;
+	DAC0.DATA = on_phase ? dac_on_value : 0;
+	uint16_t write_delay = TCA0.SINGLE.CNT;
+	// PER for this phase was loaded from PERBUF at the OVF, buffer the next one
+	TCA0.SINGLE.PERBUF = (on_phase ? off_ticks : on_ticks) - 1;
+	TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+
+	if (on_phase) {
+		period_count++;
+	}
+	if (write_delay < write_delay_min) {
+		write_delay_min = write_delay;
+	}
+	if (write_delay > write_delay_max) {
+		write_delay_max = write_delay;
+	}
+	uint16_t handled = TCA0.SINGLE.CNT;
+	if (handled > handled_max) {
+		handled_max = handled;
+	}
+}
+
+uint16_t get_strobe_jitter_us() {
+	uint16_t spread;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (period_count == 0) {
+			return 0;
+		}
+		spread = write_delay_max - write_delay_min;
+	}
+	return (uint32_t)spread * 1000000UL / timer_hz;
+}
+
+uint16_t get_strobe_max_frequency_hz() {
+	uint16_t handled;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		handled = handled_max;
+	}
+	if (handled == 0) {
+		return 0;
+	}
+	// Each period has two edges, each handled before its phase could end
+	uint32_t frequency = timer_hz / (2UL * handled);
+	return frequency > 0xFFFF ? 0xFFFF : frequency;
+}
+
+uint16_t get_strobe_period_count() {
+	uint16_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		count = period_count;
+	}
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef STROBE_H_
+#define STROBE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Design constant, not measured: settling time of the LED current after a DAC step
+#define STROBE_MIN_ON_TIME_MS 2
+
+// Output must already be on at the strobe level, the TCA0 interrupt then switches
+// DAC0 between that level and 0 while the MP3432 keeps running
+void start_strobe(uint16_t period_ms, uint16_t on_time_ms);
+void stop_strobe();
+bool is_strobe_running();
+// Called on CPU clock changes, TCA0 runs from CLK_PER
+void update_strobe_clock();
+
+// Measured since start: spread of the DAC write delay after each timer edge,
+// and the frequency at which every edge would still be handled within its phase,
+// both resolved to one TCA0 tick
+uint16_t get_strobe_jitter_us();
+uint16_t get_strobe_max_frequency_hz();
+uint16_t get_strobe_period_count();
+
+#endif /* STROBE_H_ */
\ No newline at end of file
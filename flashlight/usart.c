@@ -1,15 +1,24 @@
 #include <avr/io.h>
+#include <stdbool.h>
 #include <stdio.h>
 
+#include "clock.h"
 #include "usart.h"
 
 /*
 USART: PB2 (default USART0 TX)
 */
 
+#define USART0_BAUD_RATE(BAUD_RATE) ((float)(get_f_cpu() * 64 / (16 * (float)BAUD_RATE)) + 0.5)
+
+static bool transmitted = false;
+
 static void USART0_sendChar(char c) {
 	while (!(USART0.STATUS & USART_DREIF_bm));
+	// Cleared here so TXCIF marks the end of the last frame
+	USART0.STATUS = USART_TXCIF_bm;
 	USART0.TXDATAL = c;
+	transmitted = true;
 }
 
 static int USART0_printChar(char c, FILE *stream) {
@@ -20,18 +29,28 @@ static int USART0_printChar(char c, FILE *stream) {
 static FILE USART_stream = FDEV_SETUP_STREAM(USART0_printChar, NULL, _FDEV_SETUP_WRITE);
 
 void USART0_init() {
-#define USART0_BAUD_RATE(BAUD_RATE) ((float)(3333333 * 64 / (16 * (float)BAUD_RATE)) + 0.5)
 	// Set TX pin as output and idle high
-	PORTB.DIRSET = PIN2_bm;
-	PORTB.OUTSET = PIN2_bm;
+	VPORTB.DIR |= PIN2_bm;
+	VPORTB.OUT |= PIN2_bm;
 	// Select alternative communication pins for USART0
 	// PORTMUX.CTRLB |= PORTMUX_USART0_ALTERNATE_gc;
 
 	// Set baud rate
-	USART0.BAUD = (uint16_t)USART0_BAUD_RATE(9600);
+	USART0_update_baud();
 	// Enable transmitter
 	USART0.CTRLB |= USART_TXEN_bm;
 
 	// Redirect
 	stdout = &USART_stream;
+}
+
+void USART0_flush() {
+	if (!transmitted) {
+		return;
+	}
+	while (!(USART0.STATUS & USART_TXCIF_bm));
+}
+
+void USART0_update_baud() {
+	USART0.BAUD = (uint16_t)USART0_BAUD_RATE(9600);
 }
\ No newline at end of file
@@ -2,5 +2,7 @@
 #define USART_H_
 
 void USART0_init();
+void USART0_flush();
+void USART0_update_baud();
 
 #endif /* USART_H_ */
\ No newline at end of file
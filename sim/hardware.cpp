@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware.h"
+#include "protection.h"
+extern "C" {
+#include "control.h"
+#include "dac.h"
+#include "strobe.h"
+}
+
+/*
+Stand-ins for control.cpp, dac.c, strobe.c and protection.cpp. They keep the
+same state the firmware keeps, but write it to OutputState instead of pins
+and registers.
+*/
+
+static OutputState output = {};
+static bool uvlo = false;
+static state_t boost_state = INVALID;
+static state_t hdr_state = INVALID;
+
+const OutputState& get_output_state() {
+	return output;
+}
+
+void reset_hardware() {
+	output = OutputState {};
+	uvlo = false;
+	boost_state = INVALID;
+	hdr_state = INVALID;
+}
+
+bool get_uvlo() {
+	return uvlo;
+}
+
+void set_uvlo() {
+	uvlo = true;
+}
+
+void reset_uvlo() {
+	uvlo = false;
+}
+
+void enable_inv() {
+}
+
+void disable_inv() {
+}
+
+state_t get_hdr_state() {
+	return hdr_state;
+}
+
+void enable_hdr() {
+	output.hdr = true;
+	hdr_state = ENABLED;
+}
+
+void disable_hdr() {
+	output.hdr = false;
+	hdr_state = DISABLED;
+}
+
+state_t get_boost_state() {
+	return boost_state;
+}
+
+void enable_boost() {
+	if (uvlo || is_tripped() || boost_state == ENABLED) {
+		return;
+	}
+	output.boost = true;
+	boost_state = ENABLED;
+}
+
+void disable_boost() {
+	output.boost = false;
+	boost_state = DISABLED;
+}
+
+void DAC0_init() {
+}
+
+void DAC0_enable() {
+}
+
+void DAC0_disable() {
+}
+
+// No thermal model, the trip never fires
+bool is_tripped() {
+	return false;
+}
+
+void start_strobe(uint16_t period_ms, uint16_t on_time_ms) {
+	output.strobe = true;
+	output.strobe_period_ms = period_ms;
+	output.strobe_on_time_ms = on_time_ms;
+}
+
+void stop_strobe() {
+	output.strobe = false;
+}
+
+bool is_strobe_running() {
+	return output.strobe;
+}
+
+uint8_t DAC0_get_vref() {
+	return output.dac_vref;
+}
+
+void DAC0_set_vref(uint8_t vref) {
+	output.dac_vref = vref;
+}
+
+uint8_t DAC0_get_data() {
+	return output.dac_data;
+}
+
+void DAC0_set_data(uint8_t data) {
+	output.dac_data = data;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef HARDWARE_H_
+#define HARDWARE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// What the firmware last wrote to the output stage, read by the models
+struct OutputState {
+	bool boost;
+	bool hdr;
+	uint8_t dac_vref;
+	uint8_t dac_data;
+	// DAC switches between dac_data and 0 while the strobe runs
+	bool strobe;
+	uint16_t strobe_period_ms;
+	uint16_t strobe_on_time_ms;
+};
+
+const OutputState& get_output_state();
+// Power cycle between simulated runs
+void reset_hardware();
+
+#endif /* HARDWARE_H_ */
\ No newline at end of file
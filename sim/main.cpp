@@ -0,0 +1,168 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "brightness.h"
+#include "hardware.h"
+#include "model.h"
+#include "modes.h"
+
+/*
+Host-side battery runtime simulator.
+Drives brightness.cpp and modes.h, unmodified from the firmware, against the
+models in model.cpp, from a full cell until the output can no longer come
+back from UVLO.
+
+Usage: flashlight-sim [capacity mAh] [resistance mOhm]
+*/
+
+// main.cpp checks the battery level at 8 Hz
+static const float TICK_S = 1.0f / 8;
+// The ramp steps once per main loop pass, which has no fixed rate in the firmware
+static const uint16_t RAMP_STEPS_PER_TICK = 64;
+static const float MAX_RUNTIME_H = 2000;
+
+static const char *const MODE_NAMES[MODE_MAX] = {
+	[MODE_ULTRA_LOW] = "ultra low",
+	[MODE_LOW] = "low",
+	[MODE_HIGH] = "high",
+	[MODE_ULTRA_HIGH] = "ultra high",
+	[MODE_RAMP_LOOP] = "ramp",
+	[MODE_STROBE] = "strobe",
+	[MODE_BEACON] = "beacon",
+};
+
+// Double, the per-tick increments are below float resolution over long runs
+struct Result {
+	double first_cut_off_h;
+	double empty_h;
+	double lit_h;
+	double lumen_h;
+	double led_wh;
+	double battery_wh;
+	uint32_t cut_offs;
+};
+
+// Draws from the cell for dt, returns the battery voltage the ADC would see
+static float draw(Cell& cell, float duty, bool sample_on, float dt, Result& result) {
+	const OutputState& output = get_output_state();
+	float ocv = cell_ocv(cell);
+	float idle = idle_power(ocv);
+	float on_power = idle + boost_input_power(output);
+	// Strobe off-phase, the DAC is at 0 but the boost keeps running
+	OutputState dark = output;
+	dark.dac_data = 0;
+	float off_power = idle + boost_input_power(dark);
+	float on_current;
+	float off_current;
+	bool on_ok = cell_current(cell, on_power, on_current);
+	cell_current(cell, off_power, off_current);
+
+	double hours = dt / 3600;
+	cell.used_ah += (duty * on_current + (1 - duty) * off_current) * hours;
+	result.battery_wh += (duty * on_power + (1 - duty) * off_power) * hours;
+	float led = on_ok ? led_current(output) : 0;
+	if (led > 0) {
+		result.lit_h += hours;
+		result.lumen_h += duty * led_lumens(led) * hours;
+		result.led_wh += duty * led * led_voltage(led) * hours;
+	}
+
+	if (!sample_on) {
+		return ocv - off_current * cell.resistance_ohm;
+	}
+	if (!on_ok) {
+		// Collapsed, reads below any UVLO threshold
+		return 0;
+	}
+	return ocv - on_current * cell.resistance_ohm;
+}
+
+static Result run(light_mode_t mode, Cell cell) {
+	// brightness.cpp keeps its state between runs, start each one from off
+	reset_hardware();
+	set_brightness(0);
+	reset_brightness_transitions();
+	float t = 0;
+	int8_t direction = 1;
+
+	Result result = {};
+	uint32_t tick = 0;
+	while (true) {
+		// The ramp steps once per main loop pass, other modes settle in one
+		uint16_t passes = mode == MODE_RAMP_LOOP ? RAMP_STEPS_PER_TICK : 1;
+		float battery_v = 0;
+		for (uint16_t i = 0; i < passes; i++) {
+			update_mode(mode, t, direction);
+			const OutputState& output = get_output_state();
+			float duty = 1;
+			bool sample_on = true;
+			if (output.strobe) {
+				duty = (float)output.strobe_on_time_ms / output.strobe_period_ms;
+				// The ADC samples wherever the 8 Hz check lands in the strobe period
+				uint32_t phase_ms = (uint32_t)(tick * TICK_S * 1000) % output.strobe_period_ms;
+				sample_on = phase_ms < output.strobe_on_time_ms;
+			}
+			battery_v = draw(cell, duty, sample_on, TICK_S / passes, result);
+		}
+
+		bool uvlo_prev = get_uvlo();
+		update_uvlo(battery_v);
+		tick++;
+		double hours = tick * (double)TICK_S / 3600;
+		if (get_uvlo() && !uvlo_prev) {
+			if (result.cut_offs == 0) {
+				result.first_cut_off_h = hours;
+			}
+			result.cut_offs++;
+		}
+
+		// Without UVLO hysteresis the output keeps coming back after each cut-off,
+		// so run until the cell is empty or cannot recover even at rest
+		if (cell_soc(cell) <= 0 || cell_ocv(cell) < UVLO_VOLTS || hours >= MAX_RUNTIME_H) {
+			result.empty_h = hours;
+			break;
+		}
+	}
+	return result;
+}
+
+static void print_groups() {
+	// Efficiency at the top of each group, the board's idle draw included
+	printf("group  hdr  vref  dac max  led mA  efficiency at 3.7 V\n");
+	for (uint8_t i = 0; i < BRIGHTNESS_GROUPS_SIZE; i++) {
+		const BrightnessGroup& bg = BRIGHTNESS_GROUPS[i];
+		OutputState output = {};
+		output.boost = true;
+		output.hdr = bg.hdr;
+		output.dac_vref = bg.dac_vref;
+		output.dac_data = bg.dac_value_min + bg.dac_value_step_count;
+		float led = led_current(output);
+		float efficiency = led * led_voltage(led) / (boost_input_power(output) + idle_power(3.7f));
+		printf("%5u  %3u  %4.2f  %7u  %6.1f  %9.1f %%\n", i, bg.hdr, (double)vref_voltage(bg.dac_vref), output.dac_data, led * 1000, efficiency * 100);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv) {
+	Cell cell = { 3.0f, 0.06f, 0 };
+	if (argc > 1) {
+		cell.capacity_ah = atof(argv[1]) / 1000;
+	}
+	if (argc > 2) {
+		cell.resistance_ohm = atof(argv[2]) / 1000;
+	}
+
+	printf("PRIORITISE_EFFICIENCY %u, UVLO_VOLTS %.2f, cell %.0f mAh %.0f mOhm\n\n", PRIORITISE_EFFICIENCY, (double)UVLO_VOLTS, cell.capacity_ah * 1000, cell.resistance_ohm * 1000);
+	print_groups();
+
+	// Runtime is until the first UVLO cut-off, lit time includes the flicker after it
+	printf("mode        runtime h  empty h   lit h  avg lm   lm-h  efficiency  cut-offs\n");
+	for (uint8_t mode = 0; mode < MODE_MAX; mode++) {
+		Result result = run(static_cast<light_mode_t>(mode), cell);
+		double average_lm = result.lit_h > 0 ? result.lumen_h / result.lit_h : 0;
+		double efficiency = result.battery_wh > 0 ? result.led_wh / result.battery_wh : 0;
+		printf("%-10s  %9.2f  %7.2f  %6.2f  %6.1f  %5.0f  %8.1f %%  %8u\n", MODE_NAMES[mode], result.first_cut_off_h, result.empty_h, result.lit_h, average_lm, result.lumen_h, efficiency * 100, result.cut_offs);
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <avr/io.h>
+#include <math.h>
+
+#include "model.h"
+
+// ===== Cell =====
+
+// 18650 class cell, OCV at 0%, 10%, ... 100% state of charge
+static const float OCV_TABLE[] = { 3.00f, 3.45f, 3.57f, 3.64f, 3.69f, 3.74f, 3.80f, 3.87f, 3.95f, 4.05f, 4.20f };
+static const uint8_t OCV_TABLE_SIZE = sizeof(OCV_TABLE) / sizeof(float);
+
+float cell_soc(const Cell& cell) {
+	float soc = 1 - cell.used_ah / cell.capacity_ah;
+	if (soc < 0) {
+		return 0;
+	}
+	return soc;
+}
+
+float cell_ocv(const Cell& cell) {
+	float position = cell_soc(cell) * (OCV_TABLE_SIZE - 1);
+	uint8_t index = position;
+	if (index >= OCV_TABLE_SIZE - 1) {
+		return OCV_TABLE[OCV_TABLE_SIZE - 1];
+	}
+	float fraction = position - index;
+	return OCV_TABLE[index] + fraction * (OCV_TABLE[index + 1] - OCV_TABLE[index]);
+}
+
+bool cell_current(const Cell& cell, float power_w, float& current_a) {
+	// P = I * (OCV - I * R), take the smaller root
+	float ocv = cell_ocv(cell);
+	float discriminant = ocv * ocv - 4 * cell.resistance_ohm * power_w;
+	if (discriminant < 0) {
+		current_a = ocv / (2 * cell.resistance_ohm);
+		return false;
+	}
+	current_a = (ocv - sqrtf(discriminant)) / (2 * cell.resistance_ohm);
+	return true;
+}
+
+// ===== LED and sense =====
+
+// HDR on at 2.5 V VREF, DAC 255
+static const float LED_MAX_CURRENT_A = 3.0f;
+// HDR switches to the sense resistor 100 times smaller, see BRIGHTNESS_GROUPS
+static const float HDR_CURRENT_RATIO = 100;
+// Sense voltage at the op-amp input per DAC volt
+static const float SENSE_VOLTS_PER_DAC_VOLT = 1 / 25.0f;
+
+// 6 V class LED
+static const float LED_VF_V = 5.5f;
+static const float LED_RESISTANCE_OHM = 0.15f;
+static const float LED_EFFICACY_LM_PER_W = 160;
+static const float LED_DROOP_A = 3.0f;
+
+float vref_voltage(uint8_t dac_vref) {
+	switch (dac_vref) {
+	case VREF_DAC0REFSEL_0V55_gc:
+		return 0.55f;
+	case VREF_DAC0REFSEL_1V1_gc:
+		return 1.1f;
+	case VREF_DAC0REFSEL_1V5_gc:
+		return 1.5f;
+	case VREF_DAC0REFSEL_2V5_gc:
+		return 2.5f;
+	case VREF_DAC0REFSEL_4V34_gc:
+		return 4.34f;
+	}
+	return 0;
+}
+
+float dac_voltage(const OutputState& output) {
+	return vref_voltage(output.dac_vref) * output.dac_data / 256;
+}
+
+float led_current(const OutputState& output) {
+	if (!output.boost) {
+		return 0;
+	}
+	static const float AMPS_PER_DAC_VOLT = LED_MAX_CURRENT_A / (2.5f * 255 / 256);
+	float current = dac_voltage(output) * AMPS_PER_DAC_VOLT;
+	if (!output.hdr) {
+		current /= HDR_CURRENT_RATIO;
+	}
+	return current;
+}
+
+float led_voltage(float current_a) {
+	return LED_VF_V + LED_RESISTANCE_OHM * current_a;
+}
+
+float led_lumens(float current_a) {
+	float power = current_a * led_voltage(current_a);
+	return power * LED_EFFICACY_LM_PER_W / (1 + current_a / LED_DROOP_A);
+}
+
+// ===== MP3432 =====
+
+static const float BOOST_CONVERSION_EFFICIENCY = 0.93f;
+// Switching and gate drive losses, dominate at the non-HDR levels
+static const float BOOST_FIXED_LOSS_W = 0.02f;
+// EN high, also at DAC 0
+static const float BOOST_QUIESCENT_W = 0.004f;
+
+float boost_input_power(const OutputState& output) {
+	if (!output.boost) {
+		return 0;
+	}
+	float current = led_current(output);
+	// The op-amp regulates the sense voltage, so its loss follows VREF, not HDR
+	float sense_power = current * dac_voltage(output) * SENSE_VOLTS_PER_DAC_VOLT;
+	float output_power = current * led_voltage(current) + sense_power;
+	if (output_power == 0) {
+		return BOOST_QUIESCENT_W;
+	}
+	return BOOST_QUIESCENT_W + output_power / BOOST_CONVERSION_EFFICIENCY + BOOST_FIXED_LOSS_W;
+}
+
+// ===== Board =====
+
+static const float MCU_CURRENT_A = 0.003f;
+
+float idle_power(float battery_v) {
+	return MCU_CURRENT_A * battery_v;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef MODEL_H_
+#define MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware.h"
+
+/*
+Models behind the firmware's outputs. The constants in model.cpp are
+datasheet-typical starting points, replace them with bench measurements of
+the actual cell, LED and board before trusting absolute runtimes.
+*/
+
+// Li-ion cell, open-circuit voltage by state of charge plus series resistance
+struct Cell {
+	float capacity_ah;
+	float resistance_ohm;
+	// Double, per-tick charge is below float resolution near full capacity
+	double used_ah;
+};
+
+float cell_ocv(const Cell& cell);
+float cell_soc(const Cell& cell);
+// Current drawn for a given input power, false if the cell collapses
+bool cell_current(const Cell& cell, float power_w, float& current_a);
+
+// DAC voltage, LED current and light output set by the firmware
+float vref_voltage(uint8_t dac_vref);
+float dac_voltage(const OutputState& output);
+float led_current(const OutputState& output);
+float led_voltage(float current_a);
+float led_lumens(float current_a);
+
+// Battery-side power while the output is on, including MP3432 and sense losses
+float boost_input_power(const OutputState& output);
+// Always drawn, mostly the MCU
+float idle_power(float battery_v);
+
+#endif /* MODEL_H_ */
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef SIM_AVR_IO_H_
+#define SIM_AVR_IO_H_
+
+// Only what brightness.h needs from the ATtiny1616 header, values match VREF.CTRLA
+
+#define VREF_DAC0REFSEL_gm 0x07
+#define VREF_DAC0REFSEL_0V55_gc 0x00
+#define VREF_DAC0REFSEL_1V1_gc 0x01
+#define VREF_DAC0REFSEL_2V5_gc 0x02
+#define VREF_DAC0REFSEL_4V34_gc 0x03
+#define VREF_DAC0REFSEL_1V5_gc 0x04
+
+#endif /* SIM_AVR_IO_H_ */
\ No newline at end of file